@@ -6,6 +6,11 @@
 
 #include "exception.hpp"
 #include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <exception>
+#include <new>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <cstdlib>
 
@@ -19,22 +24,101 @@ namespace n88
     * that STL containers require copy constructors.  The objects
     * stored in ObjectGroup must however have a default constructor (one
     * that takes no arguments).
+    *
+    * The objects are stored in a single block.  Each object starts on a
+    * new cache line, so that objects used by different threads do not
+    * share cache lines, and object i is found by computing its address
+    * rather than through a pointer.
     */
   template <typename TObject>
   class ObjectGroup : private boost::noncopyable
   {
 
+    public:
+
+      /** Objects are aligned to and padded to a multiple of this. */
+      static constexpr size_t cache_line_size = 64;
+
     protected:
 
-      std::vector<TObject*> m_Objects;
+      char* m_Block;
+      size_t m_Size;
+      size_t m_Stride;
+      size_t m_Alignment;
+      // Offset of the TObject within each object, which may be derived.
+      size_t m_Offset;
+      // Calls the destructor of the type that was constructed.
+      void (*m_Destructor)(char*);
+
+      template <class TDerivedObject>
+      static void destroy_object(char* p)
+      {
+        reinterpret_cast<TDerivedObject*>(p)->~TDerivedObject();
+      }
+
+      /** Allocates the block for n objects of type TDerivedObject. */
+      template <class TDerivedObject>
+      void allocate(size_t n)
+      {
+        n88_assert(this->m_Size == 0);
+        this->m_Alignment = std::max(cache_line_size, alignof(TDerivedObject));
+        this->m_Stride = ((sizeof(TDerivedObject) + this->m_Alignment - 1)
+                          / this->m_Alignment) * this->m_Alignment;
+        if (n > size_t(-1) / this->m_Stride)
+          { throw_n88_exception("ObjectGroup is too large."); }
+        this->m_Block = static_cast<char*>(::operator new(
+            n*this->m_Stride, std::align_val_t(this->m_Alignment)));
+        this->m_Destructor = &ObjectGroup::destroy_object<TDerivedObject>;
+      }
+
+      /** Destroys objects [begin,end) in reverse order. */
+      void destroy_range(size_t begin, size_t end)
+      {
+        while (end > begin)
+        {
+          --end;
+          this->m_Destructor(this->m_Block + end*this->m_Stride);
+        }
+      }
+
+      void deallocate()
+      {
+        ::operator delete(this->m_Block, std::align_val_t(this->m_Alignment));
+        this->m_Block = NULL;
+        this->m_Size = 0;
+      }
+
+      /** Records the number of objects once all are constructed. */
+      template <class TDerivedObject>
+      void set_constructed(size_t n)
+      {
+        this->m_Offset = reinterpret_cast<char*>(static_cast<TObject*>(
+            reinterpret_cast<TDerivedObject*>(this->m_Block))) - this->m_Block;
+        this->m_Size = n;
+      }
 
     public:
 
       /** Default constructor.  Creates an empty ObjectGroup. */
-      ObjectGroup() {}
+      ObjectGroup()
+        :
+        m_Block (NULL),
+        m_Size (0),
+        m_Stride (0),
+        m_Alignment (cache_line_size),
+        m_Offset (0),
+        m_Destructor (NULL)
+      {}
 
       /** Constructor that sets size of ObjectGroup to n, creating n objects. */
       ObjectGroup(size_t n)
+        :
+        m_Block (NULL),
+        m_Size (0),
+        m_Stride (0),
+        m_Alignment (cache_line_size),
+        m_Offset (0),
+        m_Destructor (NULL)
       {
         this->construct<TObject>(n);
       }
@@ -50,10 +134,98 @@ namespace n88
       template <class TDerivedObject>
       void construct(size_t n)
       {
-        n88_assert(this->m_Objects.size() == 0);
-        for (size_t i=0; i<n; ++i) {
-          this->m_Objects.push_back(new TDerivedObject());
+        n88_assert(this->m_Size == 0);
+        if (n == 0)
+          { return; }
+        this->allocate<TDerivedObject>(n);
+        size_t i = 0;
+        try
+        {
+          for (; i<n; ++i) {
+            new (this->m_Block + i*this->m_Stride) TDerivedObject();
+          }
+        }
+        catch (...)
+        {
+          this->destroy_range(0, i);
+          this->deallocate();
+          throw;
+        }
+        this->set_constructed<TDerivedObject>(n);
+      }
+
+      /** As construct, but constructs the objects on multiple threads.
+        * This is useful if the constructors are expensive, or to have
+        * each object's memory first touched by a different thread.
+        *
+        * @param n        The number of objects.
+        * @param threads  The number of threads to use.  If 0, uses the
+        *                 hardware concurrency.  If fewer threads can be
+        *                 started, the calling thread does the rest.
+        */
+      template <class TDerivedObject>
+      void construct_parallel(size_t n, size_t threads = 0)
+      {
+        n88_assert(this->m_Size == 0);
+        if (n == 0)
+          { return; }
+        if (threads == 0)
+          { threads = std::max(1u, std::thread::hardware_concurrency()); }
+        threads = std::min(threads, n);
+        // Thread t constructs objects [begin[t], begin[t+1]).
+        std::vector<size_t> begin (threads + 1);
+        std::vector<size_t> constructed (threads, 0);
+        std::vector<std::exception_ptr> errors (threads);
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t t=0; t<=threads; ++t) {
+          begin[t] = (n*t)/threads;
         }
+        this->allocate<TDerivedObject>(n);
+        auto work = [&] (size_t t)
+          {
+            try
+            {
+              for (size_t i=begin[t]; i<begin[t+1]; ++i) {
+                new (this->m_Block + i*this->m_Stride) TDerivedObject();
+                ++constructed[t];
+              }
+            }
+            catch (...)
+            {
+              errors[t] = std::current_exception();
+            }
+          };
+        size_t started = 1;
+        try
+        {
+          for (; started<threads; ++started) {
+            pool.push_back(std::thread(work, started));
+          }
+        }
+        catch (const std::system_error&)
+        {
+          // Out of threads; the chunks not started are constructed below.
+        }
+        work(0);
+        for (size_t t=started; t<threads; ++t) {
+          work(t);
+        }
+        for (size_t t=0; t<pool.size(); ++t) {
+          pool[t].join();
+        }
+        for (size_t t=0; t<threads; ++t)
+        {
+          if (errors[t])
+          {
+            for (size_t u=threads; u>0; --u) {
+              this->destroy_range(begin[u-1], begin[u-1] + constructed[u-1]);
+            }
+            this->deallocate();
+            std::rethrow_exception(errors[t]);
+          }
+        }
+        this->set_constructed<TDerivedObject>(n);
       }
 
       /** Sets the size of ObjectGroup to 0, calling the destructors of
@@ -61,34 +233,33 @@ namespace n88
         */
       void destroy()
       {
-        while (!this->m_Objects.empty())
-        {
-          delete this->m_Objects.back();
-          this->m_Objects.pop_back();
-        }
+        if (this->m_Size == 0)
+          { return; }
+        this->destroy_range(0, this->m_Size);
+        this->deallocate();
       }
 
       /** Returns the size (number of objects) of ObjectGroup. */
       size_t size() const {
-        return this->m_Objects.size(); }
+        return this->m_Size; }
 
       bool is_constructed() const {
-        return !this->m_Objects.empty(); }
-        
+        return this->m_Size != 0; }
+
       /** Returns a reference to object i. */
       TObject& operator[](size_t n) const
       {
 #ifdef RANGE_CHECKING
-        n88_assert(n < m_Objects.size());
+        n88_assert(n < this->m_Size);
 #endif
-        return *this->m_Objects[n];
+        return *reinterpret_cast<TObject*>(this->m_Block + this->m_Offset + n*this->m_Stride);
       }
 //       const TObject& operator[](size_t n) const
 //       {
 // #ifdef RANGE_CHECKING
-//         n88_assert(n < m_Objects.size());
+//         n88_assert(n < this->m_Size);
 // #endif
-//         return *this->m_Objects[n];
+//         return *reinterpret_cast<TObject*>(this->m_Block + this->m_Offset + n*this->m_Stride);
 //       }
 
   };
@@ -5,39 +5,162 @@
 #define N88UTIL_TimeStamp_hpp_INCLUDED
 
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 #include <boost/timer/timer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
 #include <ostream>
+#include <string>
+#if defined(_WIN32)
+#include <boost/winapi/get_current_thread.hpp>
+#include <boost/winapi/get_thread_times.hpp>
+#endif
 
 namespace n88
 {
 
+/** Measures elapsed time since construction (or the last Restart).
+  *
+  * Three clocks are available:
+  *
+  *   CPU         User plus system CPU time of the process.  This is the
+  *               sum over all threads, so it over-reports multi-threaded
+  *               phases and does not include time spent waiting for I/O.
+  *   WALL        Elapsed real time from a monotonic clock.
+  *   THREAD_CPU  CPU time of the calling thread.  The TimeStamp must be
+  *               read on the thread that started it.  Where the platform
+  *               provides neither CLOCK_THREAD_CPUTIME_ID nor (on
+  *               Windows) GetThreadTimes, this is whatever std::clock
+  *               measures, usually the CPU time of the process.
+  *
+  * CPU is the default, for compatibility.
+  */
 class TimeStamp
 {
   public:
 
-  	TimeStamp()
+    enum mode_t {CPU, WALL, THREAD_CPU};
+
+    TimeStamp(mode_t mode = CPU)
       :
-      m_format (boost::format("%7.2f "))
-      {}
+      m_mode (mode),
+      m_start (0)
+      {
+        if (mode == CPU)
+        { this->m_timer.emplace(); }
+        this->Restart();
+      }
 
-  	void SetFormat(std::string f)
+    /** Sets the format used by Print.  It must accept a single floating
+      * point value, in seconds.  The default is "%7.2f ".
+      */
+    void SetFormat(std::string f)
     {
       this->m_format = boost::format(f);
     }
 
+    mode_t GetMode() const
+    {
+      return this->m_mode;
+    }
+
+    /** Resets the elapsed time to zero. */
+    void Restart()
+    {
+      if (this->m_mode == CPU)
+      { this->m_timer->start(); }
+      else
+      { this->m_start = this->Now(); }
+    }
+
+    /** Elapsed time in nanoseconds.  Does not allocate. */
+    int64_t ElapsedNanoseconds() const
+    {
+      if (this->m_mode == CPU)
+      {
+        boost::timer::cpu_times const elapsed_times (this->m_timer->elapsed());
+        return elapsed_times.system + elapsed_times.user;
+      }
+      return this->Now() - this->m_start;
+    }
+
+    /** Elapsed time in seconds.  Does not allocate. */
+    double Elapsed() const
+    {
+      return this->ElapsedNanoseconds() / 1000000000.0;
+    }
+
+    /** Writes the elapsed time to text, which has size n, and returns the
+      * number of characters written (not including the terminating null).
+      * Does not allocate unless a format has been set with SetFormat.
+      */
+    size_t Print(char* text, size_t n) const
+    {
+      if (n == 0)
+      { return 0; }
+      const double elapsed = this->Elapsed();
+      if (!this->m_format)
+      {
+        const int written = snprintf (text, n, "%7.2f ", elapsed);
+        return written < 0 ? 0 : std::min (size_t(written), n - 1);
+      }
+      boost::format f = *this->m_format;  // copy to avoid discarding const
+      const std::string s = (f % elapsed).str();
+      const size_t count = std::min (s.size(), n - 1);
+      s.copy (text, count);
+      text[count] = '\0';
+      return count;
+    }
+
     std::string Print() const
     {
-      boost::timer::cpu_times const elapsed_times (this->m_timer.elapsed());
-      boost::timer::nanosecond_type const elapsed_ns (
-                             elapsed_times.system + elapsed_times.user);
-      double elapsed = elapsed_ns / 1000000000.0;
-      boost::format f = this->m_format;  // copy to avoid discarding const
-      return (f % elapsed).str();
+      if (!this->m_format)
+      {
+        char text[64];
+        return std::string (text, this->Print (text, sizeof(text)));
+      }
+      boost::format f = *this->m_format;  // copy to avoid discarding const
+      return (f % this->Elapsed()).str();
     }
 
   protected:
-    boost::timer::cpu_timer m_timer;
-    boost::format m_format;
+
+    // The current time in nanoseconds for the WALL and THREAD_CPU modes.
+    int64_t Now() const
+    {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+      if (this->m_mode == THREAD_CPU)
+      {
+        timespec t;
+        clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t);
+        return int64_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+      }
+#elif defined(_WIN32)
+      if (this->m_mode == THREAD_CPU)
+      {
+        boost::winapi::FILETIME_ creation, exit, kernel, user;
+        boost::winapi::GetThreadTimes (boost::winapi::GetCurrentThread(),
+                                       &creation, &exit, &kernel, &user);
+        const uint64_t ticks =
+            ((uint64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime)
+            + ((uint64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime);
+        return int64_t(ticks) * 100;  // 100 ns units
+      }
+#else
+      if (this->m_mode == THREAD_CPU)
+      { return int64_t(double(std::clock()) * (1E9 / CLOCKS_PER_SEC)); }
+#endif
+      return std::chrono::duration_cast<std::chrono::nanoseconds> (
+                 std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    mode_t m_mode;
+    boost::optional<boost::timer::cpu_timer> m_timer;  // CPU mode only.
+    int64_t m_start;
+    boost::optional<boost::format> m_format;  // Only if set with SetFormat.
 };
 
 }  // namespace
@@ -5,18 +5,64 @@
 #ifndef N88UTIL_TrackingAllocator_hpp_INCLUDED
 #define N88UTIL_TrackingAllocator_hpp_INCLUDED
 
-#include <boost/thread/tss.hpp>
+#include <cstdint>
 #include <cstdlib>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
 #include "n88util_export.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
+// N88_CALL_SITE() gives the address that the calling function will return
+// to, which identifies the code calling it, provided that the calling
+// function is declared N88_NOINLINE.
+#if defined(__GNUC__) || defined(__clang__)
+#define N88_NOINLINE __attribute__((noinline))
+#define N88_CALL_SITE() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#define N88_NOINLINE __declspec(noinline)
+#define N88_CALL_SITE() _ReturnAddress()
+#else
+#define N88_NOINLINE
+#define N88_CALL_SITE() NULL
+#endif
 
 namespace n88
 {
 
   struct N88UTIL_EXPORT TrackingAllocatorValues
   {
+    // Net bytes allocated by this thread.  May be negative if this thread
+    // frees memory allocated by another thread.
+    int64_t current;
+    int64_t peak;
+    // Changes not yet merged into the global totals.
+    int64_t pending;
+    size_t pending_count;
+  };
+
+  /** Allocations with sizes in [min_size, max_size]. */
+  struct N88UTIL_EXPORT TrackingAllocatorSizeClass
+  {
+    size_t min_size;
+    size_t max_size;
+    size_t allocations;
+    size_t frees;
+    size_t bytes;
+  };
+
+  /** Allocations attributed to a tag. */
+  struct N88UTIL_EXPORT TrackingAllocatorTagStatistics
+  {
+    std::string tag;
+    size_t allocations;
+    size_t frees;
     size_t current;
     size_t peak;
+    size_t bytes;
   };
 
   /**
@@ -25,22 +71,134 @@ namespace n88
    * this class is that the counter is statically allocated per-thread:
    * every thread gets its own. Thus you can safely use it in multi-threaded
    * programs without the speed impact of mutexes or atomic operations.
+   *
+   * The per-thread counts are also merged into process-wide totals,
+   * which are atomic.  A thread merges its changes once they amount to
+   * merge_threshold bytes, when it exits, and when it calls
+   * merge_allocated or one of the get_global functions.  The global
+   * totals are therefore correct even when memory is freed on a
+   * different thread than allocated it, but may lag by up to
+   * merge_threshold bytes for each thread.
+   *
+   * Optionally, allocations made with allocate can also be counted by
+   * size class (powers of 2) and attributed to tags, which are set
+   * with scoped_tag or passed to allocate.  Untagged allocations are
+   * attributed to the address they were called from (e.g. the function
+   * calling array::construct), given where possible as a module and
+   * offset that can be resolved with addr2line.
+   * This is disabled by default.  When enabled, each allocation costs
+   * some atomic operations, plus a lock to look up a tag passed to
+   * allocate, or the first time a thread allocates from a call site.
+   *
+   * A memory budget can be set with a soft and a hard limit on the global
+   * total.  An allocation that would exceed the hard limit fails (so
+   * that array::construct throws), unless a callback frees enough memory
+   * first.  An allocation that would exceed the soft limit calls the
+   * callback, which may reject it.  While limits are set, allocations
+   * are checked against the exact global total, and frees are merged
+   * immediately.  external_increase is counted but never rejected.
    */
   class N88UTIL_EXPORT TrackingAllocator
   {
     public:
       static void* allocate(size_t size);
+      static void* allocate(size_t size, const char* tag);
+
+      /** As allocate, but aligned to alignment, which must be a power of
+        * 2.  allocate gives the alignment of malloc.  Freed with release.
+        */
+      static void* allocate_aligned (size_t size, size_t alignment);
+
+      /** As allocate_aligned, but an untagged allocation is attributed to
+        * site instead of the caller.  This allows a function that
+        * allocates on behalf of its caller to attribute the allocation to
+        * the caller, by passing N88_CALL_SITE().
+        */
+      static void* allocate_aligned (size_t size, size_t alignment, const void* site);
+
       static void release(void* p, size_t size);
       static void external_increase (size_t size);
       static void external_decrease (size_t size);
       static size_t get_current_allocated();
       static size_t get_peak_allocated();
-      
-    private:
-      static boost::thread_specific_ptr<TrackingAllocatorValues> allocated;
+
+      /** Merges this thread's changes into the global totals. */
+      static void merge_allocated();
+
+      /** Bytes currently allocated by all threads. */
+      static size_t get_global_current_allocated();
+
+      /** The maximum of get_global_current_allocated over time. */
+      static size_t get_global_peak_allocated();
+
+      /** The number of allocations made by all threads. */
+      static size_t get_global_allocation_count();
+
+      /** Threads merge their changes when they amount to this many bytes. */
+      static const int64_t merge_threshold = 64*1024;
+
+      /** Enables size class and tag statistics.  Only allocations made
+        * while enabled are counted.
+        */
+      static void set_statistics_enabled (bool enabled);
+      static bool get_statistics_enabled ();
+
+      /** The size classes in which there have been allocations. */
+      static std::vector<TrackingAllocatorSizeClass> get_size_histogram ();
+
+      /** Statistics for each tag, in order of first use. */
+      static std::vector<TrackingAllocatorTagStatistics> get_tag_statistics ();
+
+      /** Writes the size histogram and tag statistics as text. */
+      static void report_statistics (std::ostream& out);
+
+      enum memory_limit_t {SOFT_LIMIT, HARD_LIMIT};
+
+      /** Called when an allocation of requested bytes would take the
+        * global total from current above limit.
+        *
+        * For SOFT_LIMIT, return false to reject the allocation.  For
+        * HARD_LIMIT, return true to have the allocation checked again,
+        * e.g. after freeing memory; it is rejected if still above the
+        * limit.  Allocations made by the callback are not passed to it.
+        */
+      typedef std::function<bool (memory_limit_t limit, size_t requested, size_t current)>
+          memory_limit_callback;
+
+      /** Sets the memory budget in bytes.  0 means no limit. */
+      static void set_memory_limits (size_t soft, size_t hard);
+
+      static size_t get_memory_limit (memory_limit_t limit);
+
+      /** Sets the function called when a limit would be exceeded.  Without
+        * one, allocations above the soft limit are allowed, and
+        * allocations above the hard limit rejected.
+        */
+      static void set_memory_limit_callback (memory_limit_callback callback);
+
+      /** The bytes that can be allocated before reaching a limit, or
+        * SIZE_MAX if there is no such limit.
+        */
+      static size_t get_memory_headroom (memory_limit_t limit = HARD_LIMIT);
+
+      /** Attributes allocations on this thread to a tag for the lifetime
+        * of the object.  Scopes may be nested.
+        */
+      class N88UTIL_EXPORT scoped_tag
+      {
+        public:
+          explicit scoped_tag (const char* tag);
+          ~scoped_tag ();
+
+        private:
+          scoped_tag (const scoped_tag&);
+          scoped_tag& operator= (const scoped_tag&);
+
+          uint32_t m_previous;
+      };
 
   };
-  
+
 } // namespace n88
 
 #endif
@@ -9,11 +9,30 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
+#if __cplusplus >= 202002L
+#include <version>
+#include <span>
+#ifdef __cpp_lib_mdspan
+#include <mdspan>
+#endif
+#endif
 
 #ifdef N88_TRACK_ALLOCATIONS
 #include "TrackingAllocator.hpp"
 #endif
 
+// With N88_TRACK_ALLOCATIONS, each allocation is attributed to the code
+// that constructed the array.  The functions that allocate are then not
+// inlined, so that they can pass on their return address.
+#ifdef N88_TRACK_ALLOCATIONS
+#define N88_ARRAY_ALLOCATES N88_NOINLINE
+#define N88_ARRAY_CALL_SITE N88_CALL_SITE()
+#else
+#define N88_ARRAY_ALLOCATES
+#define N88_ARRAY_CALL_SITE NULL
+#endif
+
 
 // Alignment in bytes
 #define N88_ARRAY_ALIGNMENT_POWER 4
@@ -54,6 +73,14 @@ namespace n88
       enum {dimension = N};
       typedef TValue value_type;
       typedef TIndex index_type;
+      typedef size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef TValue* pointer;
+      typedef TValue& reference;
+      // Raw pointers are contiguous iterators, so the array can be passed
+      // directly to STL (including parallel) algorithms and C++20 ranges.
+      typedef TValue* iterator;
+      typedef const TValue* const_iterator;
 
       /** Empty constructor.
         * You must subsequently call construct or construct_reference explicitly.
@@ -71,14 +98,14 @@ namespace n88
         *
         * @param dims  The dimensions of the array to allocate.
         */
-      explicit array_base(tuplet<N,TIndex> dims)
+      N88_ARRAY_ALLOCATES explicit array_base(tuplet<N,TIndex> dims)
         :
         m_base             (NULL),
         m_size             (0),
         m_buffer           (NULL),
         m_end              (NULL),
         m_dims             (tuplet<N,TIndex>::zeros())
-      { construct(dims); }
+      { this->construct(dims, N88_ARRAY_CALL_SITE); }
 
       /** Constructor to create reference to existing data defined by a pointer.
         * The referenced data will never be freed by this object.  You
@@ -120,34 +147,8 @@ namespace n88
         *
         * @param dims  The dimensions of the array to allocate.
         */
-      void construct(tuplet<N,TIndex> dims)
-      {
-        if (this->m_base)
-        { throw_n88_exception("array is already constructed."); }
-        this->m_size = long_product(dims);
-        this->m_dims = dims;
-        try
-#ifdef N88_TRACK_ALLOCATIONS
-        { this->m_buffer = (TValue*)TrackingAllocator::allocate(this->m_size*sizeof(TValue)); }
-#else
-        { this->m_buffer = new TValue[this->m_size]; }
-#endif
-        catch (...)
-        { throw_n88_exception("Unable to allocate memory."); }
-        if (this->m_buffer == NULL)
-        { throw_n88_exception("Unable to allocate memory."); }
-        // In OS's that use lazy allocation, calling memset may ensure that
-        // memory is contiguous in real address space, which could be advantageous.
-        memset (this->m_buffer, 0, this->m_size*sizeof(TValue));
-        this->m_base = this->m_buffer;
-        // For now, just throw an exception if the alignment is not correct.
-        // If this crops up, will need to re-implement alignment.
-        // Note that malloc is only guaranteed to 8 byte alignment, but in
-        // practice on many systems is actually 16 byte aligned.
-        if (size_t(this->m_base) & N88_ARRAY_ALIGNMENT_MASK)
-        { throw_n88_exception("array alignment error"); }
-        this->m_end = this->m_base + this->m_size;
-      }
+      N88_ARRAY_ALLOCATES void construct(tuplet<N,TIndex> dims)
+      { this->construct(dims, N88_ARRAY_CALL_SITE); }
 
       /** Allocate space if not already done.
         *
@@ -157,13 +158,8 @@ namespace n88
         *
         * @param dims  The dimensions of the array to allocate.
         */
-      void construct_if_required(tuplet<N,TIndex> dims)
-      {
-        if (this->m_base)
-        { n88_assert (dims == this->m_dims); }
-        else
-        { this->construct(dims); }
-      }
+      N88_ARRAY_ALLOCATES void construct_if_required(tuplet<N,TIndex> dims)
+      { this->construct_if_required(dims, N88_ARRAY_CALL_SITE); }
 
       /** Allocate space if not already done.
         *
@@ -173,16 +169,8 @@ namespace n88
         *
         * @param dims  The dimensions of the array to allocate.
         */
-      void construct_or_zero(tuplet<N,TIndex> dims)
-      {
-        if (this->m_base)
-        {
-          n88_assert (dims == this->m_dims);
-          this->zero();
-        }
-        else
-        { this->construct(dims); }
-      }
+      N88_ARRAY_ALLOCATES void construct_or_zero(tuplet<N,TIndex> dims)
+      { this->construct_or_zero(dims, N88_ARRAY_CALL_SITE); }
 
       /** Create a reference to existing data defined by a pointer.
         * The referenced data will never be freed by this object.  You
@@ -236,6 +224,10 @@ namespace n88
       inline size_t size() const
       { return this->m_size; }
 
+      /** Returns true if the array has no elements. */
+      inline bool empty() const
+      { return (this->m_size == 0); }
+
       /** Returns the dimensions of the array. */
       inline tuplet<N,TIndex> dims() const
       { return this->m_dims; }
@@ -272,6 +264,19 @@ namespace n88
       inline TValue* verify_data(TValue* p) const
       { return const_cast<TValue*>(this->verify_data(static_cast<const TValue*>(p))); }
 
+      /** Pointer to the first element of the array data.  Together with end,
+        * this allows the array to be used with STL algorithms and range-based
+        * for loops.
+        */
+      inline TValue* begin() const
+      {
+#ifdef RANGE_CHECKING
+        if (!this->m_base)
+        { throw_n88_exception("array is not constructed."); }
+#endif
+        return this->m_base;
+      }
+
       /** Pointer to the last element plus one of the array data.  This
         * may be used in loops various STL algorithms that require an end
         * value.
@@ -285,6 +290,23 @@ namespace n88
         return this->m_end;
       }
 
+#if __cplusplus >= 202002L
+      /** Returns a std::span referencing the flattened (1D) data. */
+      inline std::span<TValue> as_span() const
+      { return std::span<TValue>(this->begin(), this->m_size); }
+
+#ifdef __cpp_lib_mdspan
+      /** Returns a std::mdspan referencing the data with the same dims and
+        * indexing order as this array.
+        */
+      inline std::mdspan<TValue, std::dextents<TIndex,N> > as_mdspan() const
+      {
+        return std::mdspan<TValue, std::dextents<TIndex,N> >(
+            this->begin(), std::span<const TIndex,N>(this->m_dims.data(), N));
+      }
+#endif
+#endif
+
       /** Converts a tuple index to the flattened 1D equivalent index. */
       inline size_t flat_index(tuplet<N,TIndex> indices) const
       {
@@ -377,6 +399,69 @@ namespace n88
         { this->m_base[i] = rhs[i]; }
       }
 
+    protected:
+
+      /** As the constructor that allocates, attributing the allocation
+        * to site.
+        */
+      array_base(tuplet<N,TIndex> dims, const void* site)
+        :
+        m_base             (NULL),
+        m_size             (0),
+        m_buffer           (NULL),
+        m_end              (NULL),
+        m_dims             (tuplet<N,TIndex>::zeros())
+      { this->construct(dims, site); }
+
+      /** As construct, attributing the allocation to site. */
+      void construct(tuplet<N,TIndex> dims, const void* site)
+      {
+        if (this->m_base)
+        { throw_n88_exception("array is already constructed."); }
+        this->m_size = long_product(dims);
+        this->m_dims = dims;
+        try
+#ifdef N88_TRACK_ALLOCATIONS
+        { this->m_buffer = (TValue*)TrackingAllocator::allocate_aligned(this->m_size*sizeof(TValue), alignof(TValue), site); }
+#else
+        { this->m_buffer = new TValue[this->m_size]; }
+#endif
+        catch (...)
+        { throw_n88_exception("Unable to allocate memory."); }
+        if (this->m_buffer == NULL)
+        { throw_n88_exception("Unable to allocate memory."); }
+        // In OS's that use lazy allocation, calling memset may ensure that
+        // memory is contiguous in real address space, which could be advantageous.
+        memset (this->m_buffer, 0, this->m_size*sizeof(TValue));
+        this->m_base = this->m_buffer;
+        // For now, just throw an exception if the alignment is not correct.
+        // If this crops up, will need to re-implement alignment.
+        // Note that malloc is only guaranteed to 8 byte alignment, but in
+        // practice on many systems is actually 16 byte aligned.
+        if (size_t(this->m_base) & N88_ARRAY_ALIGNMENT_MASK)
+        { throw_n88_exception("array alignment error"); }
+        this->m_end = this->m_base + this->m_size;
+      }
+
+      void construct_if_required(tuplet<N,TIndex> dims, const void* site)
+      {
+        if (this->m_base)
+        { n88_assert (dims == this->m_dims); }
+        else
+        { this->construct(dims, site); }
+      }
+
+      void construct_or_zero(tuplet<N,TIndex> dims, const void* site)
+      {
+        if (this->m_base)
+        {
+          n88_assert (dims == this->m_dims);
+          this->zero();
+        }
+        else
+        { this->construct(dims, site); }
+      }
+
   }; // class array_base
 
   // ---------------------------------------------------------------------
@@ -453,7 +538,7 @@ namespace n88
         *
         * @param dims  The dimensions of the array to allocate.
         */
-      explicit array(tuplet<N,TIndex> dims)  : array_base<N,TValue,TIndex>(dims) {}
+      N88_ARRAY_ALLOCATES explicit array(tuplet<N,TIndex> dims)  : array_base<N,TValue,TIndex>(dims, N88_ARRAY_CALL_SITE) {}
 
       /** Constructor to create reference to existing data defined by a pointer.
         * The referenced data will never be freed by this object.  You
@@ -487,8 +572,8 @@ namespace n88
 
       array() : array_base<1,TValue,TIndex>() {}
 
-      explicit array(tuplet<1,TIndex> dims)  : array_base<1,TValue,TIndex>(dims) {}
-      explicit array(TIndex size)  : array_base<1,TValue,TIndex>(tuplet<1,TIndex>(size)) {}
+      N88_ARRAY_ALLOCATES explicit array(tuplet<1,TIndex> dims)  : array_base<1,TValue,TIndex>(dims, N88_ARRAY_CALL_SITE) {}
+      N88_ARRAY_ALLOCATES explicit array(TIndex size)  : array_base<1,TValue,TIndex>(tuplet<1,TIndex>(size), N88_ARRAY_CALL_SITE) {}
 
       explicit array(TValue* data, tuplet<1,TIndex> dims) : array_base<1,TValue,TIndex>(data, dims) {}
       explicit array(TValue* data, TIndex size) : array_base<1,TValue,TIndex>(data, tuplet<1,TIndex>(size)) {}
@@ -497,14 +582,14 @@ namespace n88
 
       ~array() { this->destruct(); }
 
-      inline void construct(TIndex dim)
-      { array_base<1,TValue,TIndex>::construct(tuplet<1,TIndex>(dim)); }
+      N88_ARRAY_ALLOCATES inline void construct(TIndex dim)
+      { array_base<1,TValue,TIndex>::construct(tuplet<1,TIndex>(dim), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_if_required(TIndex dim)
-      { array_base<1,TValue,TIndex>::construct_if_required(tuplet<1,TIndex>(dim)); }
+      N88_ARRAY_ALLOCATES inline void construct_if_required(TIndex dim)
+      { array_base<1,TValue,TIndex>::construct_if_required(tuplet<1,TIndex>(dim), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_or_zero(TIndex dim)
-      { array_base<1,TValue,TIndex>::construct_or_zero(tuplet<1,TIndex>(dim)); }
+      N88_ARRAY_ALLOCATES inline void construct_or_zero(TIndex dim)
+      { array_base<1,TValue,TIndex>::construct_or_zero(tuplet<1,TIndex>(dim), N88_ARRAY_CALL_SITE); }
 
       inline void construct_reference(TValue* data, TIndex dim)
       { array_base<1,TValue,TIndex>::construct_reference(data, tuplet<1,TIndex>(dim)); }
@@ -532,9 +617,9 @@ namespace n88
 
       array() : array_base<2,TValue,TIndex>() {}
 
-      explicit array(tuplet<2,TIndex> dims)  : array_base<2,TValue,TIndex>(dims) {}
-      explicit array(TIndex dim0, TIndex dim1)
-          : array_base<2,TValue,TIndex>(tuplet<2,TIndex>(dim0, dim1)) {}
+      N88_ARRAY_ALLOCATES explicit array(tuplet<2,TIndex> dims)  : array_base<2,TValue,TIndex>(dims, N88_ARRAY_CALL_SITE) {}
+      N88_ARRAY_ALLOCATES explicit array(TIndex dim0, TIndex dim1)
+          : array_base<2,TValue,TIndex>(tuplet<2,TIndex>(dim0, dim1), N88_ARRAY_CALL_SITE) {}
 
       explicit array(TValue* data, tuplet<2,TIndex> dims) : array_base<2,TValue,TIndex>(data, dims) {}
       explicit array(TValue* data, TIndex dim0, TIndex dim1)
@@ -544,14 +629,14 @@ namespace n88
 
       ~array() { this->destruct(); }
 
-      inline void construct(TIndex dim0, TIndex dim1)
-      { array_base<2,TValue,TIndex>::construct(tuplet<2,TIndex>(dim0,dim1)); }
+      N88_ARRAY_ALLOCATES inline void construct(TIndex dim0, TIndex dim1)
+      { array_base<2,TValue,TIndex>::construct(tuplet<2,TIndex>(dim0,dim1), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_if_required(TIndex dim0, TIndex dim1)
-      { array_base<2,TValue,TIndex>::construct_if_required(tuplet<2,TIndex>(dim0,dim1)); }
+      N88_ARRAY_ALLOCATES inline void construct_if_required(TIndex dim0, TIndex dim1)
+      { array_base<2,TValue,TIndex>::construct_if_required(tuplet<2,TIndex>(dim0,dim1), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_or_zero(TIndex dim0, TIndex dim1)
-      { array_base<2,TValue,TIndex>::construct_or_zero(tuplet<2,TIndex>(dim0,dim1)); }
+      N88_ARRAY_ALLOCATES inline void construct_or_zero(TIndex dim0, TIndex dim1)
+      { array_base<2,TValue,TIndex>::construct_or_zero(tuplet<2,TIndex>(dim0,dim1), N88_ARRAY_CALL_SITE); }
 
       inline void construct_reference(TValue* data, TIndex dim0, TIndex dim1)
       { array_base<2,TValue,TIndex>::construct_reference(data, tuplet<2,TIndex>(dim0,dim1)); }
@@ -585,9 +670,9 @@ namespace n88
 
       array() : array_base<3,TValue,TIndex>() {}
 
-      explicit array(tuplet<3,TIndex> dims)  : array_base<3,TValue,TIndex>(dims) {}
-      explicit array(TIndex dim0, TIndex dim1, TIndex dim2)
-          : array_base<3,TValue,TIndex>(tuplet<3,TIndex>(dim0, dim1, dim2)) {}
+      N88_ARRAY_ALLOCATES explicit array(tuplet<3,TIndex> dims)  : array_base<3,TValue,TIndex>(dims, N88_ARRAY_CALL_SITE) {}
+      N88_ARRAY_ALLOCATES explicit array(TIndex dim0, TIndex dim1, TIndex dim2)
+          : array_base<3,TValue,TIndex>(tuplet<3,TIndex>(dim0, dim1, dim2), N88_ARRAY_CALL_SITE) {}
 
       explicit array(TValue* data, tuplet<3,TIndex> dims) : array_base<3,TValue,TIndex>(data, dims) {}
       explicit array(TValue* data, TIndex dim0, TIndex dim1, TIndex dim2)
@@ -597,14 +682,14 @@ namespace n88
 
       ~array() { this->destruct(); }
 
-      inline void construct(TIndex dim0, TIndex dim1, TIndex dim2)
-      { array_base<3,TValue,TIndex>::construct(tuplet<3,TIndex>(dim0,dim1,dim2)); }
+      N88_ARRAY_ALLOCATES inline void construct(TIndex dim0, TIndex dim1, TIndex dim2)
+      { array_base<3,TValue,TIndex>::construct(tuplet<3,TIndex>(dim0,dim1,dim2), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_if_required(TIndex dim0, TIndex dim1, TIndex dim2)
-      { array_base<3,TValue,TIndex>::construct_if_required(tuplet<3,TIndex>(dim0,dim1,dim2)); }
+      N88_ARRAY_ALLOCATES inline void construct_if_required(TIndex dim0, TIndex dim1, TIndex dim2)
+      { array_base<3,TValue,TIndex>::construct_if_required(tuplet<3,TIndex>(dim0,dim1,dim2), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_or_zero(TIndex dim0, TIndex dim1, TIndex dim2)
-      { array_base<3,TValue,TIndex>::construct_or_zero(tuplet<3,TIndex>(dim0,dim1,dim2)); }
+      N88_ARRAY_ALLOCATES inline void construct_or_zero(TIndex dim0, TIndex dim1, TIndex dim2)
+      { array_base<3,TValue,TIndex>::construct_or_zero(tuplet<3,TIndex>(dim0,dim1,dim2), N88_ARRAY_CALL_SITE); }
 
       inline void construct_reference(TValue* data, TIndex dim0, TIndex dim1, TIndex dim2)
       { array_base<3,TValue,TIndex>::construct_reference(data, tuplet<3,TIndex>(dim0,dim1,dim2)); }
@@ -640,9 +725,9 @@ namespace n88
 
       array() : array_base<4,TValue,TIndex>() {}
 
-      explicit array(tuplet<4,TIndex> dims)  : array_base<4,TValue,TIndex>(dims) {}
-      explicit array(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
-          : array_base<4,TValue,TIndex>(tuplet<4,TIndex>(dim0, dim1, dim2, dim3)) {}
+      N88_ARRAY_ALLOCATES explicit array(tuplet<4,TIndex> dims)  : array_base<4,TValue,TIndex>(dims, N88_ARRAY_CALL_SITE) {}
+      N88_ARRAY_ALLOCATES explicit array(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
+          : array_base<4,TValue,TIndex>(tuplet<4,TIndex>(dim0, dim1, dim2, dim3), N88_ARRAY_CALL_SITE) {}
 
       explicit array(TValue* data, tuplet<4,TIndex> dims) : array_base<4,TValue,TIndex>(data, dims) {}
       explicit array(TValue* data, TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
@@ -652,14 +737,14 @@ namespace n88
 
       ~array() { this->destruct(); }
 
-      inline void construct(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
-      { array_base<4,TValue,TIndex>::construct(tuplet<4,TIndex>(dim0,dim1,dim2,dim3)); }
+      N88_ARRAY_ALLOCATES inline void construct(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
+      { array_base<4,TValue,TIndex>::construct(tuplet<4,TIndex>(dim0,dim1,dim2,dim3), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_if_required(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
-      { array_base<4,TValue,TIndex>::construct_if_required(tuplet<4,TIndex>(dim0,dim1,dim2,dim3)); }
+      N88_ARRAY_ALLOCATES inline void construct_if_required(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
+      { array_base<4,TValue,TIndex>::construct_if_required(tuplet<4,TIndex>(dim0,dim1,dim2,dim3), N88_ARRAY_CALL_SITE); }
 
-      inline void construct_or_zero(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
-      { array_base<4,TValue,TIndex>::construct_or_zero(tuplet<4,TIndex>(dim0,dim1,dim2,dim3)); }
+      N88_ARRAY_ALLOCATES inline void construct_or_zero(TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
+      { array_base<4,TValue,TIndex>::construct_or_zero(tuplet<4,TIndex>(dim0,dim1,dim2,dim3), N88_ARRAY_CALL_SITE); }
 
       inline void construct_reference(TValue* data, TIndex dim0, TIndex dim1, TIndex dim2, TIndex dim3)
       { array_base<4,TValue,TIndex>::construct_reference(data, tuplet<4,TIndex>(dim0,dim1,dim2,dim3)); }
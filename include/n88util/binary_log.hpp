@@ -0,0 +1,215 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_binary_log_hpp_INCLUDED
+#define N88UTIL_binary_log_hpp_INCLUDED
+
+#include "n88util_export.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace n88
+{
+
+  namespace io
+  {
+
+    /** Record types in a binary log.
+      *
+      * A binary log starts with the 8 bytes "N88BLOG1" followed by the
+      * uint32_t 0x01020304 in the byte order of the writer (which the
+      * decoder requires to be its own).  Then follows a sequence of
+      * records, each starting with a one byte record type:
+      *
+      *   BINARY_LOG_DEFINE:  uint32_t id, uint32_t format length, format,
+      *                       uint32_t number of arguments, argument tags.
+      *   BINARY_LOG_EVENT:   uint32_t id, uint64_t timestamp, uint8_t level,
+      *                       arguments.
+      *   BINARY_LOG_CLOCK:   uint64_t timestamp, int64_t nanoseconds since
+      *                       the system clock epoch.
+      *
+      * Each format is defined before its first event.  Timestamps are in
+      * CPU time stamp counter ticks where available, otherwise in
+      * steady_clock nanoseconds; the decoder converts them using the CLOCK
+      * records, which are written when the log is started and on each
+      * flush.
+      *
+      * Arguments are written in their raw representation according to
+      * their tags: '?' bool, 'c' char (1 byte); 'i' int32_t, 'I' uint32_t,
+      * 'q' int64_t, 'Q' uint64_t, 'f' float, 'd' double; 's' string
+      * (uint32_t length followed by the characters).
+      */
+    enum binary_log_record_t {
+      BINARY_LOG_DEFINE = 1,
+      BINARY_LOG_EVENT = 2,
+      BINARY_LOG_CLOCK = 3
+    };
+
+    /** The time stamp written with binary log events.
+      *
+      * This is the CPU time stamp counter where available, otherwise
+      * steady_clock nanoseconds.  It is defined in the library so that
+      * this header does not need the compiler intrinsics headers.
+      */
+    N88UTIL_EXPORT uint64_t binary_log_timestamp ();
+
+    /** Describes how to write an argument type to a binary log.
+      *
+      * Only the specializations below are defined, so logging an argument
+      * of any other type is a compile-time error.
+      */
+    template <typename T, typename Enable = void> struct binary_log_arg;
+
+    template <typename T>
+    struct binary_log_arg<T, typename std::enable_if<std::is_integral<T>::value>::type>
+    {
+      // Integers are widened to 32 or 64 bits.
+      typedef typename std::conditional<std::is_same<T,bool>::value || std::is_same<T,char>::value,
+                T,
+                typename std::conditional<std::is_signed<T>::value,
+                  typename std::conditional<(sizeof(T) <= 4), int32_t, int64_t>::type,
+                  typename std::conditional<(sizeof(T) <= 4), uint32_t, uint64_t>::type
+                >::type
+              >::type stored_type;
+      static constexpr char tag =
+          std::is_same<T,bool>::value ? '?' :
+          std::is_same<T,char>::value ? 'c' :
+          std::is_signed<T>::value ? (sizeof(T) <= 4 ? 'i' : 'q')
+                                   : (sizeof(T) <= 4 ? 'I' : 'Q');
+      static void write (std::streambuf& out, T x)
+      {
+        const stored_type v = (stored_type)x;
+        out.sputn ((const char*)&v, sizeof(v));
+      }
+    };
+
+    template <>
+    struct binary_log_arg<float>
+    {
+      static constexpr char tag = 'f';
+      static void write (std::streambuf& out, float x)
+      { out.sputn ((const char*)&x, sizeof(x)); }
+    };
+
+    template <>
+    struct binary_log_arg<double>
+    {
+      static constexpr char tag = 'd';
+      static void write (std::streambuf& out, double x)
+      { out.sputn ((const char*)&x, sizeof(x)); }
+    };
+
+    template <>
+    struct binary_log_arg<std::string_view>
+    {
+      static constexpr char tag = 's';
+      static void write (std::streambuf& out, std::string_view x)
+      {
+        const uint32_t n = (uint32_t)x.size();
+        out.sputn ((const char*)&n, sizeof(n));
+        out.sputn (x.data(), n);
+      }
+    };
+
+    template <>
+    struct binary_log_arg<std::string> : binary_log_arg<std::string_view> {};
+
+    template <>
+    struct binary_log_arg<const char*> : binary_log_arg<std::string_view> {};
+
+    template <>
+    struct binary_log_arg<char*> : binary_log_arg<std::string_view> {};
+
+    /** A format string for binary log events.
+      *
+      * The format string is text with a "{}" placeholder for each argument.
+      * It is written to the log only once; each event refers to it by an
+      * id, which is assigned on first use, together with the argument
+      * types.  The argument types must therefore be the same for every
+      * use, which is the case if each binary_log_format is a static at a
+      * single call site, as with N88_LOG_BINARY.
+      */
+    class N88UTIL_EXPORT binary_log_format
+    {
+      public:
+
+        /** format must be a string literal or otherwise outlive the
+          * program's logging.
+          */
+        explicit binary_log_format (const char* format)
+          :
+          m_format (format),
+          m_id (0)
+        {}
+
+        template <typename... Args>
+        uint32_t id () const
+        {
+          const uint32_t id = this->m_id.load (std::memory_order_acquire);
+          if (id != 0)
+          { return id; }
+          static const char tags[] = { binary_log_arg<typename std::decay<Args>::type>::tag..., '\0' };
+          return this->Register (tags);
+        }
+
+        const char* format () const
+        { return this->m_format; }
+
+        /** Looks up a format by id.  Returns false if there is no such id. */
+        static bool Lookup (uint32_t id, std::string& format, std::string& tags);
+
+      protected:
+
+        uint32_t Register (const char* tags) const;
+
+        const char* m_format;
+        mutable std::atomic<uint32_t> m_id;
+    };
+
+    /** Writes a binary log event to a buffer. */
+    template <typename... Args>
+    void write_binary_log_event (std::streambuf& out,
+                                 uint32_t id,
+                                 uint8_t level,
+                                 const Args&... args)
+    {
+      char header[1 + sizeof(uint32_t) + sizeof(uint64_t) + 1];
+      header[0] = BINARY_LOG_EVENT;
+      const uint64_t timestamp = binary_log_timestamp();
+      memcpy (header + 1, &id, sizeof(id));
+      memcpy (header + 1 + sizeof(id), &timestamp, sizeof(timestamp));
+      header[sizeof(header) - 1] = (char)level;
+      out.sputn (header, sizeof(header));
+      (binary_log_arg<typename std::decay<Args>::type>::write (out, args), ...);
+    }
+
+    /** Converts a binary log to text.
+      *
+      * Each event is written on a line, preceded by the time in seconds
+      * since the log was started and the name of its level.
+      *
+      * The input is read sequentially; only the events since the last
+      * CLOCK record are held in memory.  Times are interpolated between the
+      * CLOCK records on either side of each event.  If the log has only
+      * one CLOCK record (for example because the program ended without
+      * flushing the log), the tick rate is unknown and all events are shown
+      * at the time of that record.
+      *
+      * @return The number of events decoded.  Throws n88_exception if the
+      *         input is not a valid binary log; events before the invalid
+      *         data may already have been written to out.
+      */
+    N88UTIL_EXPORT size_t decode_binary_log (std::istream& in, std::ostream& out);
+
+  }  // namespace io
+
+}  // namespace n88
+
+#endif
@@ -14,10 +14,20 @@
 #define __n88util_binhex_h
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <iosfwd>
 #include "n88util_export.h"
 
 namespace n88util
 {
+
+  /** Letter cases accepted when decoding hexadecimal. */
+  enum hex_case_t {
+    HEX_UPPER_CASE,   // Only 'A' to 'F'.
+    HEX_ANY_CASE      // 'A' to 'F' and 'a' to 'f'.
+  };
   /**
   \brief Encodes a binary buffer to a hexadecimal string.
   \param buf The input binary buffer.
@@ -52,6 +62,135 @@ namespace n88util
   */
   N88UTIL_EXPORT int hextobin(const std::string& hex, unsigned char** buf, long *len);
 
+  /**
+  \brief Encodes a binary buffer to hexadecimal in a caller-provided buffer.
+  \param buf The input binary buffer.
+  \param len The length of buf.
+  \param hex The output buffer.
+  \param hex_size The size of hex; must be at least 2*len.
+  \return 1 on success; 0 if hex is too small.
+
+  Exactly 2*len characters are written, without a terminating null.
+  No memory is allocated.
+  */
+  N88UTIL_EXPORT int bintohex(const unsigned char *buf, size_t len, char* hex, size_t hex_size);
+
+  /**
+  \brief Appends the hexadecimal encoding of a binary buffer to a string.
+  The string is grown once to the exact final size, so no memory is
+  allocated if it already has sufficient capacity.
+  \return 1 on success; 0 otherwise.
+  */
+  N88UTIL_EXPORT int bintohex_append(const unsigned char *buf, size_t len, std::string& hex);
+
+  /**
+  \brief Version that appends to a vector of characters.
+  */
+  N88UTIL_EXPORT int bintohex_append(const unsigned char *buf, size_t len, std::vector<char>& hex);
+
+  /**
+  \brief Decodes hexadecimal to a binary caller-provided buffer.
+  \param hex The input hexadecimal encoding (need not be null-terminated).
+  \param buf The output buffer.
+  \param buf_size The size of buf; must be at least hex.size()/2.
+  \return 1 on success; 0 if hex contains invalid characters or buf is
+  too small.
+
+  As for the other versions of hextobin, a trailing unpaired character is
+  ignored.  No memory is allocated.
+  */
+  N88UTIL_EXPORT int hextobin(std::string_view hex, unsigned char* buf, size_t buf_size);
+
+  /**
+  \brief Version that can accept lower case and report errors.
+  \param letter_case Whether lower case letters are accepted.
+  \param invalid_position If not NULL, returns the index in hex of the first
+  invalid character, or the number of characters decoded if all are valid.
+  If buf_size is too small, nothing is decoded and std::string_view::npos
+  is returned.
+
+  Validation and decoding are done in a single pass.
+  */
+  N88UTIL_EXPORT int hextobin(std::string_view hex, unsigned char* buf, size_t buf_size,
+                              hex_case_t letter_case, size_t* invalid_position = NULL);
+
+  /**
+  \brief Appends the binary decoding of a hexadecimal string to a vector.
+  The vector is grown once to the exact final size.  On failure, it is
+  restored to its original size.
+  \return 1 on success; 0 if hex contains invalid characters.
+  */
+  N88UTIL_EXPORT int hextobin_append(std::string_view hex, std::vector<unsigned char>& buf);
+
+  /**
+  \brief Version that can accept lower case and report errors.
+  See the corresponding version of hextobin.
+  */
+  N88UTIL_EXPORT int hextobin_append(std::string_view hex, std::vector<unsigned char>& buf,
+                                     hex_case_t letter_case, size_t* invalid_position = NULL);
+
+  /**
+  \brief Incremental decoder for hexadecimal data supplied in chunks.
+
+  Chunks may be of any length, including odd lengths: an unpaired character
+  at the end of one chunk is held and combined with the first character of
+  the next.  Memory use is constant.
+
+  Example:
+  \code
+    n88util::hex_decoder decoder;
+    while (read_chunk(hex, &len))
+    {
+      size_t n;
+      if (!decoder.update(hex, len, buf, &n)) { error... }
+      consume(buf, n);
+    }
+  \endcode
+  */
+  class N88UTIL_EXPORT hex_decoder
+  {
+    public:
+
+      explicit hex_decoder(hex_case_t letter_case = HEX_UPPER_CASE);
+
+      /**
+      \brief Decodes a chunk of hexadecimal characters.
+      \param hex The input characters.
+      \param len The number of characters in hex.
+      \param buf The output buffer; must have room for (len+1)/2 bytes.
+      \param written Returns the number of bytes written to buf.
+      \return 1 on success; 0 if hex contains an invalid character.
+      */
+      int update(const char* hex, size_t len, unsigned char* buf, size_t* written);
+
+      /** \brief Returns true if an unpaired character is being held. */
+      bool pending() const { return this->m_has_pending; }
+
+      /** \brief Discards any held character, ready for new input. */
+      void reset() { this->m_has_pending = false; }
+
+    protected:
+
+      hex_case_t m_letter_case;
+      char m_pending;
+      bool m_has_pending;
+  };
+
+  /**
+  \brief Encodes binary data from a stream to hexadecimal on another stream.
+  Data is processed in fixed-size chunks, so memory use is constant.
+  \return 1 on success; 0 on a stream error.
+  */
+  N88UTIL_EXPORT int bintohex(std::istream& in, std::ostream& out);
+
+  /**
+  \brief Decodes hexadecimal from a stream to binary data on another stream.
+  Data is processed in fixed-size chunks, so memory use is constant.  As for
+  the other versions of hextobin, a trailing unpaired character is ignored.
+  \return 1 on success; 0 on invalid input or a stream error.
+  */
+  N88UTIL_EXPORT int hextobin(std::istream& in, std::ostream& out);
+
 }   // namespace n88util
 
 #endif  // #ifndef __n88util_binhex_h
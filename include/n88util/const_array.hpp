@@ -5,6 +5,9 @@
 #define N88UTIL_const_array_hpp_INCLUDED
 
 #include "array.hpp"
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
 
 
 namespace n88
@@ -38,6 +41,13 @@ namespace n88
       enum {dimension = N};
       typedef TValue value_type;
       typedef TIndex index_type;
+      typedef size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const TValue* pointer;
+      typedef const TValue& reference;
+      // As for array_base, iterators are raw pointers.
+      typedef const TValue* iterator;
+      typedef const TValue* const_iterator;
 
       /** Empty constructor.
         * You must subsequently call construct or construct_reference explicitly.
@@ -150,6 +160,10 @@ namespace n88
       inline size_t size() const
       { return this->m_size; }
 
+      /** Returns true if the const_array has no elements. */
+      inline bool empty() const
+      { return (this->m_size == 0); }
+
       /** Returns the dimensions of the const_array. */
       inline tuplet<N,TIndex> dims() const
       { return this->m_dims; }
@@ -186,6 +200,19 @@ namespace n88
       inline TValue* verify_data(TValue* p) const
       { return const_cast<TValue*>(this->verify_data(static_cast<const TValue*>(p))); }
 
+      /** Pointer to the first element of the array data.  Together with end,
+        * this allows the const_array to be used with STL algorithms and range-based
+        * for loops.
+        */
+      inline const TValue* begin() const
+      {
+#ifdef RANGE_CHECKING
+        if (!this->m_base)
+        { throw_n88_exception("const_array is not constructed."); }
+#endif
+        return this->m_base;
+      }
+
       /** Pointer to the last element plus one of the array data.  This
         * may be used in loops various STL algorithms that require an end
         * value.
@@ -199,6 +226,23 @@ namespace n88
         return this->m_end;
       }
 
+#if __cplusplus >= 202002L
+      /** Returns a std::span referencing the flattened (1D) data. */
+      inline std::span<const TValue> as_span() const
+      { return std::span<const TValue>(this->begin(), this->m_size); }
+
+#ifdef __cpp_lib_mdspan
+      /** Returns a std::mdspan referencing the data with the same dims and
+        * indexing order as this const_array.
+        */
+      inline std::mdspan<const TValue, std::dextents<TIndex,N> > as_mdspan() const
+      {
+        return std::mdspan<const TValue, std::dextents<TIndex,N> >(
+            this->begin(), std::span<const TIndex,N>(this->m_dims.data(), N));
+      }
+#endif
+#endif
+
       /** Converts a tuple index to the flattened 1D equivalent index. */
       inline size_t flat_index(tuplet<N,TIndex> indices) const
       {
@@ -459,4 +503,11 @@ namespace n88
 
 } // namespace n88
 
+#if __cplusplus >= 202002L
+// const_array never owns its data, so iterators obtained from a temporary
+// const_array remain valid.
+template <int N, typename TValue, typename TIndex>
+inline constexpr bool std::ranges::enable_borrowed_range<n88::const_array<N,TValue,TIndex> > = true;
+#endif
+
 #endif
@@ -0,0 +1,278 @@
+/*=========================================================================
+
+                              delimited_text
+
+  Reading of delimited numeric text into arrays.
+
+  Copyright (c) Eric Nodwell
+  See LICENSE for details.
+
+=========================================================================*/
+
+
+#ifndef __n88util_delimited_text_h
+#define __n88util_delimited_text_h
+
+#include "n88util/text.hpp"
+#include "n88util/array.hpp"
+#include "n88util/exception.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/format.hpp>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace n88util
+{
+
+  /** \brief Parses a number occupying all of [begin,end).
+   *
+   * Uses std::from_chars, which does no allocation and is not affected by
+   * the locale.  A leading '+' is accepted.
+   *
+   * \return true on success.
+   */
+  template <typename T>
+  bool parse_number(const char* begin, const char* end, T& value)
+    {
+    if (begin != end && *begin == '+')
+      {
+      ++begin;
+      }
+#if !defined(__cpp_lib_to_chars)
+    // Standard libraries without floating point from_chars.
+    if constexpr (std::is_floating_point<T>::value)
+      {
+      char buffer[64];
+      const size_t n = end - begin;
+      if (n == 0 || n >= sizeof(buffer))
+        {
+        return false;
+        }
+      memcpy(buffer, begin, n);
+      buffer[n] = '\0';
+      char* parsed_end;
+      value = (T)strtod(buffer, &parsed_end);
+      return parsed_end == buffer + n;
+      }
+    else
+#endif
+      {
+      const std::from_chars_result result = std::from_chars(begin, end, value);
+      return result.ec == std::errc() && result.ptr == end;
+      }
+    }
+
+  /** \brief Parses delimited numeric text into a 2D array.
+   *
+   * Each non-blank line of text becomes a row of data; every row must have
+   * the same number of values.  Separators are as for split_arguments
+   * (repeated separators are treated as one), with '\r' also treated as a
+   * separator so that DOS line endings are handled.
+   *
+   * data is constructed with dims (rows, columns).  If it is already
+   * constructed, its dims must match.
+   *
+   * Large inputs are split at line boundaries and parsed in parallel.
+   * Throws n88_exception on invalid input.
+   *
+   * \param text  The text to parse.
+   * \param data  The array to fill.
+   * \param separators  The separator characters; NULL for " \t\r,".
+   * \param threads  The number of threads to use; 0 for the number of
+   *                 hardware threads.
+   */
+  template <typename T, typename TIndex>
+  void parse_delimited(std::string_view text,
+                       n88::array<2,T,TIndex>& data,
+                       const char* separators = NULL,
+                       unsigned int threads = 0)
+    {
+    const separator_set sep(separators ? separators : " \t\r,");
+    if (threads == 0)
+      {
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+    // Not worth starting threads for less than this much text per thread.
+    const size_t min_chunk_size = size_t(1) << 18;
+    threads = (unsigned int)std::max(std::min(size_t(threads), text.size() / min_chunk_size), size_t(1));
+
+    // Chunk boundaries, each at the start of a line.
+    std::vector<const char*> bounds(threads + 1);
+    const char* const text_end = text.data() + text.size();
+    bounds[0] = text.data();
+    bounds[threads] = text_end;
+    for (unsigned int t=1; t<threads; ++t)
+      {
+      const char* p = std::max(text.data() + t*(text.size()/threads), bounds[t-1]);
+      p = (const char*)memchr(p, '\n', text_end - p);
+      bounds[t] = p ? p + 1 : text_end;
+      }
+
+    // Calls f(line, line_end) for each line in chunk t.
+    const auto for_each_line = [&bounds](unsigned int t, auto f)
+      {
+      const char* p = bounds[t];
+      const char* const end = bounds[t+1];
+      while (p != end)
+        {
+        const char* line_end = (const char*)memchr(p, '\n', end - p);
+        if (!line_end)
+          {
+          line_end = end;
+          }
+        f(p, line_end);
+        p = (line_end == end) ? end : line_end + 1;
+        }
+      };
+
+    // Runs f(t) for each chunk, on separate threads if there are several.
+    const auto run = [threads](auto f)
+      {
+      if (threads == 1)
+        {
+        f(0);
+        return;
+        }
+      std::vector<std::exception_ptr> errors(threads);
+      std::vector<std::thread> pool;
+      for (unsigned int t=0; t<threads; ++t)
+        {
+        pool.emplace_back([&f, &errors, t]()
+          {
+          try { f(t); }
+          catch (...) { errors[t] = std::current_exception(); }
+          });
+        }
+      for (std::thread& thread : pool)
+        {
+        thread.join();
+        }
+      for (const std::exception_ptr& e : errors)
+        {
+        if (e)
+          {
+          std::rethrow_exception(e);
+          }
+        }
+      };
+
+    // First pass: count lines and rows (non-blank lines) in each chunk.
+    std::vector<size_t> lines(threads + 1, 0);
+    std::vector<size_t> rows(threads + 1, 0);
+    run([&](unsigned int t)
+      {
+      for_each_line(t, [&](const char* line, const char* line_end)
+        {
+        ++lines[t+1];
+        if (sep.find_first_not(line, line_end) != line_end)
+          {
+          ++rows[t+1];
+          }
+        });
+      });
+    for (unsigned int t=0; t<threads; ++t)
+      {
+      lines[t+1] += lines[t];
+      rows[t+1] += rows[t];
+      }
+
+    // The number of columns is given by the first row.
+    size_t columns = 0;
+    for (const char* line = text.data(); line != text_end && columns == 0; )
+      {
+      const char* line_end = (const char*)memchr(line, '\n', text_end - line);
+      if (!line_end)
+        {
+        line_end = text_end;
+        }
+      for_each_argument(std::string_view(line, line_end - line), sep,
+                        [&columns](std::string_view) { ++columns; });
+      line = (line_end == text_end) ? text_end : line_end + 1;
+      }
+
+    if (data.is_constructed())
+      {
+      n88_assert(data.dims()[0] == TIndex(rows[threads]) && data.dims()[1] == TIndex(columns));
+      }
+    else
+      {
+      data.construct(TIndex(rows[threads]), TIndex(columns));
+      }
+
+    // Second pass: parse.
+    run([&](unsigned int t)
+      {
+      size_t line_number = lines[t];
+      T* p = data.data() + rows[t]*columns;
+      for_each_line(t, [&](const char* line, const char* line_end)
+        {
+        ++line_number;
+        size_t n = 0;
+        for_each_argument(std::string_view(line, line_end - line), sep,
+          [&](std::string_view token)
+          {
+          if (n < columns && !parse_number(token.data(), token.data() + token.size(), p[n]))
+            {
+            throw_n88_exception(boost::format("Invalid number \"%s\" on line %d.")
+                                % std::string(token) % line_number);
+            }
+          ++n;
+          });
+        if (n != 0 && n != columns)
+          {
+          throw_n88_exception(boost::format("Expected %d values on line %d; found %d.")
+                              % columns % line_number % n);
+          }
+        p += n;
+        });
+      });
+    }
+
+  /** \brief Reads a file of delimited numeric text into a 2D array.
+   *
+   * The file is memory-mapped and parsed with parse_delimited, so it is
+   * never copied into a buffer.
+   */
+  template <typename T, typename TIndex>
+  void load_delimited(const char* filename,
+                      n88::array<2,T,TIndex>& data,
+                      const char* separators = NULL,
+                      unsigned int threads = 0)
+    {
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(filename, ec);
+    if (ec)
+      {
+      throw_n88_exception(boost::format("Unable to read file %s.") % filename);
+      }
+    if (size == 0)
+      {
+      // Zero-length files cannot be mapped.
+      parse_delimited(std::string_view(), data, separators, threads);
+      return;
+      }
+    try
+      {
+      boost::interprocess::file_mapping file(filename, boost::interprocess::read_only);
+      boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+      parse_delimited(std::string_view((const char*)region.get_address(), region.get_size()),
+                      data, separators, threads);
+      }
+    catch (boost::interprocess::interprocess_exception&)
+      {
+      throw_n88_exception(boost::format("Unable to read file %s.") % filename);
+      }
+    }
+
+}   // namespace n88util
+
+#endif  // #ifndef __n88util_delimited_text_h
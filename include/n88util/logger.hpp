@@ -5,9 +5,20 @@
 #define N88UTIL_logger_hpp_INCLUDED
 
 #include "n88util/TimeStamp.hpp"
+#include "n88util/binary_log.hpp"
+#include "n88util_export.h"
 #include <boost/noncopyable.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <streambuf>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
 
 
 namespace n88
@@ -16,7 +27,15 @@ namespace n88
   namespace io
   {
 
+    /** Message levels, in increasing order of importance.
+      *
+      * VERBOSE was added below INFORMATIVE, so the numeric values of the
+      * other levels are one greater than in earlier versions.  Code that
+      * stores or compares levels as integers must be updated, and code
+      * using LogLevel_t must be recompiled.
+      */
     enum LogLevel_t {
+      VERBOSE,
       INFORMATIVE,
       IMPORTANT,
       ERROR
@@ -24,50 +43,376 @@ namespace n88
 
     struct console_only_class { console_only_class () {} };
 
+    struct verbose_level_class { verbose_level_class () {} };
+
     struct informative_level_class { informative_level_class () {} };
 
     struct important_level_class { important_level_class () {} };
 
     struct error_level_class { error_level_class () {} };
 
-    class logger : private boost::noncopyable
+    /** A growable buffer with an ostream interface, used to format log
+      * output.
+      *
+      * The storage is kept when the buffer is cleared, so once it has grown
+      * to the size of the largest message, formatting does not allocate.
+      */
+    class N88UTIL_EXPORT log_buffer : public std::streambuf
+    {
+      public:
+
+        log_buffer ();
+
+        std::ostream& stream ()
+        { return this->m_stream; }
+
+        const char* data () const
+        { return this->pbase(); }
+
+        size_t size () const
+        { return this->pptr() - this->pbase(); }
+
+        /** Discards everything after the first n characters. */
+        void truncate (size_t n)
+        {
+          this->setp (this->pbase(), this->epptr());
+          this->pbump ((int)n);
+        }
+
+        /** Returns a buffer for the exclusive use of the calling thread.
+          * Output is appended to it and removed again with truncate, so that
+          * nested use works.
+          */
+        static log_buffer& for_thread ();
+
+      protected:
+
+        virtual int_type overflow (int_type c);
+        virtual std::streamsize xsputn (const char* s, std::streamsize n);
+
+        void reserve (size_t n);
+
+        std::vector<char> m_storage;
+        std::ostream m_stream;
+    };
+
+    /** A history of log messages with bounded memory use.
+      *
+      * Messages are kept in a circular buffer.  When either limit is
+      * reached, the oldest messages are discarded, or, if a spill file is
+      * set, moved to the spill file.  Spill files are rotated when they
+      * reach a given size.
+      *
+      * Positions in the history are counted in bytes from the first byte
+      * ever appended, so a reader can keep a cursor and retrieve only what
+      * has been added since (see ReadSince).
+      *
+      * Not synchronized; logger guards its history with a mutex.
+      */
+    class N88UTIL_EXPORT log_history : private boost::noncopyable
     {
       public:
 
-        logger ()
-          :
-          m_logLevel (IMPORTANT),
-          m_consoleLevel (INFORMATIVE),
-          m_suppress (false)
-        {}
-      
+        log_history ();
+
+        /** Destructor.  If there is a spill file, the messages still held
+          * are written to it, so that the spill files hold the complete log.
+          */
+        ~log_history ();
+
+        /** Sets the maximum number of bytes and of messages held.  0 means
+          * no limit.  The defaults are 64 MB and no limit.
+          */
+        void SetLimits (size_t maxBytes, size_t maxMessages);
+
+        /** Sets a file to which discarded messages are written.
+          *
+          * When the file would exceed maxFileBytes, it is renamed to
+          * filename.1 (and any filename.1 to filename.2, and so on, keeping
+          * at most maxFiles old files) and a new file is started.  An
+          * existing file is overwritten.  An empty filename turns spilling
+          * off.
+          */
+        void SetSpillFile (const std::string& filename,
+                           size_t maxFileBytes,
+                           int maxFiles);
+
+        /** Appends a message. */
+        void Append (const char* s, size_t n);
+
+        /** Returns all messages held. */
+        std::string Get () const;
+
+        /** Appends to text everything from position cursor to the end,
+          * and returns the position of the end.  If cursor is older than
+          * the oldest message held, the text starts at the oldest message.
+          */
+        uint64_t ReadSince (uint64_t cursor, std::string& text) const;
+
+        /** Returns the position of the oldest byte held. */
+        uint64_t Begin () const
+        { return this->m_begin; }
+
+        /** Returns the position after the newest byte held. */
+        uint64_t End () const
+        { return this->m_end; }
+
+      protected:
+
+        void Discard (uint64_t position);
+        void Reallocate (size_t capacity);
+        void Copy (uint64_t from, uint64_t to, char* p) const;
+        void Spill (const char* s, size_t n);
+        void Rotate ();
+
+        std::vector<char> m_buffer;         // Position p is at p % m_buffer.size().
+        uint64_t m_begin;
+        uint64_t m_end;
+        std::deque<uint64_t> m_messages;    // Start positions of messages held.
+        size_t m_maxBytes;
+        size_t m_maxMessages;
+        std::string m_spillName;
+        std::ofstream m_spill;
+        size_t m_spillBytes;
+        size_t m_maxSpillBytes;
+        int m_maxSpillFiles;
+    };
+
+    class log_async_writer;
+    class logger;
+
+    /** A single log message, which is committed to the logger as a whole
+      * when the log_message is destroyed.
+      *
+      * The message is formatted into a buffer belonging to the current
+      * thread, so any number of threads may build messages for the same
+      * logger concurrently, and messages are never interleaved.  No lock is
+      * taken until the message is committed, and none at all in
+      * asynchronous mode.
+      *
+      * If the level of the message is not enabled in the logger, nothing is
+      * formatted.  The arguments are still evaluated though; to avoid that,
+      * use N88_LOG or logger::Log.
+      *
+      * Normally obtained from logger::Message and used as a temporary:
+      * @code
+      *   log.Message (n88::io::IMPORTANT) << "Iteration " << i << "\n";
+      * @endcode
+      */
+    class N88UTIL_EXPORT log_message : private boost::noncopyable
+    {
+      public:
+
+        log_message (logger& owner, LogLevel_t level);
+
+        ~log_message ();
+
+        template <typename T>
+        log_message& operator<< (const T& msg)
+        {
+          if (this->m_buffer)
+          {
+            this->m_buffer->stream() << msg;
+          }
+          return *this;
+        }
+
+        /** Makes this message go to the console only, and not to the log. */
+        log_message& operator<< (const console_only_class&)
+        {
+          this->m_toLog = false;
+          return *this;
+        }
+
+      protected:
+
+        logger& m_owner;
+        log_buffer* m_buffer;   // NULL if the message is filtered out.
+        size_t m_start;
+        bool m_toLog;
+        bool m_toConsole;
+    };
+
+    /** A logger that writes to the console and keeps a log in memory.
+      *
+      * By default every output is written to the console and flushed
+      * immediately.  In asynchronous mode (see SetAsynchronous), output is
+      * instead formatted into a buffer owned by the calling thread and
+      * copied into a lock-free queue for that thread; a background thread
+      * collects the queued output of all threads and writes it in batches.
+      *
+      * logger may be used from several threads at once.  Each use of
+      * operator<< is written as a unit, but the level and console_only
+      * manipulators are shared by all threads, so threads should log with
+      * Message, which keeps these per message.
+      */
+    class N88UTIL_EXPORT logger : private boost::noncopyable
+    {
+      public:
+
+        logger ();
+
+        /** Destructor.  In asynchronous mode, all pending output is
+          * written first.
+          */
+        virtual ~logger ();
+
         virtual LogLevel_t GetLogLevel ()
-        { return this->m_logLevel; }
-      
+        { return this->m_logLevel.load (std::memory_order_relaxed); }
+
         virtual void SetConsoleLevel (LogLevel_t level)
-        { this->m_consoleLevel = level; }
+        { this->m_consoleLevel.store (level, std::memory_order_relaxed); }
         virtual LogLevel_t GetConsoleLevel ()
-        { return this->m_consoleLevel; }
+        { return this->m_consoleLevel.load (std::memory_order_relaxed); }
 
-        virtual std::string GetLog()
-        { return this->m_log.str(); }
+        /** Sets the lowest level of output kept in the log (see GetLog and
+          * ReadLog).
+          * The default is INFORMATIVE.
+          */
+        virtual void SetHistoryLevel (LogLevel_t level)
+        { this->m_historyLevel.store (level, std::memory_order_relaxed); }
+        virtual LogLevel_t GetHistoryLevel ()
+        { return this->m_historyLevel.load (std::memory_order_relaxed); }
 
-        template <typename T>
-        logger& operator<< (const T& msg)
+        /** Returns true if output at level goes anywhere, either to the
+          * console or to the log.
+          */
+        bool IsEnabled (LogLevel_t level) const
+        {
+          return level >= this->m_consoleLevel.load (std::memory_order_relaxed)
+              || level >= this->m_historyLevel.load (std::memory_order_relaxed);
+        }
+
+        /** Sets the stream written to as the console.  The default is
+          * std::cout.  It may be, for example, a std::ofstream to log to a
+          * file.  The stream must remain valid while the logger uses it.
+          */
+        virtual void SetConsoleStream (std::ostream& stream);
+
+        /** Returns the log.  This is the history of output, less output
+          * that exceeds the limits set with SetHistoryLimits.
+          */
+        virtual std::string GetLog();
+
+        /** Appends to text everything added to the log since position
+          * cursor, and returns the new position.  Start with a cursor of 0.
+          *
+          * In asynchronous mode, recent output may not have reached the log
+          * yet; call Flush first if it must be included.
+          */
+        virtual uint64_t ReadLog (uint64_t cursor, std::string& text);
+
+        /** Sets limits on the size of the log.  See log_history::SetLimits. */
+        virtual void SetHistoryLimits (size_t maxBytes, size_t maxMessages = 0);
+
+        /** Sets a file for output discarded from the log.  See
+          * log_history::SetSpillFile.
+          */
+        virtual void SetHistoryFile (const std::string& filename,
+                                     size_t maxFileBytes = size_t(64) << 20,
+                                     int maxFiles = 4);
+
+        /** Turns asynchronous mode on or off.
+          *
+          * In asynchronous mode the calling thread does not wait for any
+          * system calls, and console output from a thread is written within
+          * a few milliseconds.  Output from different threads is not
+          * interleaved within a call to operator<<, but may be reordered
+          * relative to other threads.
+          *
+          * Must not be called while other threads are using the logger.
+          */
+        virtual void SetAsynchronous (bool asynchronous);
+        virtual bool GetAsynchronous ()
+        { return this->m_async.get() != NULL; }
+
+        /** Waits until all output so far has been written to the console
+          * and the log, and flushes the console stream.
+          */
+        virtual void Flush ();
+
+        /** Sets a stream to which binary log events are written (see
+          * LogBinary), or NULL to stop binary logging.  The stream should
+          * be opened in binary mode, and must remain valid while the logger
+          * uses it.  The binary log is decoded to text with
+          * decode_binary_log or the n88logdecode tool.
+          */
+        virtual void SetBinaryStream (std::ostream* stream);
+
+        /** Returns true if binary events at level are written.  Binary
+          * events are subject to the history level.
+          */
+        bool IsBinaryEnabled (LogLevel_t level) const
+        {
+          return this->m_binaryEnabled.load (std::memory_order_relaxed)
+              && level >= this->m_historyLevel.load (std::memory_order_relaxed);
+        }
+
+        /** Writes an event to the binary log.
+          *
+          * Rather than formatting text, the event records the id of the
+          * format, a time stamp and the raw bytes of the arguments, which
+          * is much faster.  Normally called through N88_LOG_BINARY.
+          */
+        template <typename... Args>
+        void LogBinary (LogLevel_t level,
+                        const binary_log_format& format,
+                        const Args&... args)
         {
-          if (this->m_suppress)
+          if (!this->IsBinaryEnabled (level))
           {
-            this->m_suppress = false;
+            return;
           }
-          else
+          log_buffer& buffer = log_buffer::for_thread();
+          const size_t start = buffer.size();
+          write_binary_log_event (buffer, format.id<Args...>(), (uint8_t)level, args...);
+          this->CommitBinary (buffer.data() + start, buffer.size() - start);
+          buffer.truncate (start);
+        }
+
+        /** Starts a message at the given level.  See log_message. */
+        log_message Message (LogLevel_t level)
+        { return log_message (*this, level); }
+
+        /** Logs a message at the given level, calling f (log_message&) to
+          * format it only if the level is enabled.
+          *
+          * @code
+          *   log.Log (n88::io::VERBOSE, [&] (n88::io::log_message& m)
+          *     { m << "Residual " << ComputeResidual() << "\n"; });
+          * @endcode
+          */
+        template <typename F>
+        void Log (LogLevel_t level, F f)
+        {
+          if (this->IsEnabled (level))
           {
-            this->m_log << msg;
+            log_message message (*this, level);
+            f (message);
           }
-          if (this->m_logLevel >= this->m_consoleLevel)
+        }
+
+        template <typename T>
+        logger& operator<< (const T& msg)
+        {
+          bool toLog = true;
+          if (this->m_suppress.load (std::memory_order_relaxed)
+              && this->m_suppress.exchange (false))
           {
-            std::cout << msg;
-            std::cout.flush();
+            toLog = false;
           }
+          const LogLevel_t level = this->GetLogLevel();
+          toLog = toLog && level >= this->GetHistoryLevel();
+          const bool toConsole = level >= this->GetConsoleLevel();
+          if (!(toLog || toConsole))
+          {
+            return *this;
+          }
+          log_buffer& buffer = log_buffer::for_thread();
+          const size_t start = buffer.size();
+          buffer.stream() << msg;
+          this->Commit (buffer.data() + start, buffer.size() - start, toLog, toConsole);
+          buffer.truncate (start);
           return *this;
         }
 
@@ -76,7 +421,9 @@ namespace n88
         // on some systems.
         logger& operator<<(const n88::TimeStamp& ts)
         {
-          this->operator<< (ts.Print());
+          char text[64];
+          ts.Print (text, sizeof(text));
+          this->operator<< ((const char*)text);
           return *this;
         }
 
@@ -86,6 +433,12 @@ namespace n88
           return *this;
         }
 
+        logger& operator<< (const verbose_level_class&)
+        {
+          this->m_logLevel = VERBOSE;
+          return *this;
+        }
+
         logger& operator<< (const informative_level_class&)
         {
           this->m_logLevel = INFORMATIVE;
@@ -104,16 +457,38 @@ namespace n88
           return *this;
         }
 
-      protected:   
+      protected:
+
+        friend class log_async_writer;
+        friend class log_message;
 
-        LogLevel_t m_logLevel;
-        LogLevel_t m_consoleLevel;
-        std::ostringstream m_log;
-        bool m_suppress;
+        /** Writes a complete message to the log and/or console. */
+        void Commit (const char* s, size_t n, bool toLog, bool toConsole);
+
+        /** Writes a binary log event. */
+        void CommitBinary (const char* s, size_t n);
+
+        // The following require m_outputMutex to be held.
+        void Output (const char* s, size_t n, unsigned int destinations);
+        void WriteBinaryRecord (const char* s, size_t n);
+        void WriteBinaryClock ();
+
+        std::atomic<LogLevel_t> m_logLevel;
+        std::atomic<LogLevel_t> m_consoleLevel;
+        std::atomic<LogLevel_t> m_historyLevel;
+        log_history m_history;
+        std::atomic<bool> m_suppress;
+        std::ostream* m_console;
+        std::ostream* m_binary;
+        std::atomic<bool> m_binaryEnabled;
+        std::vector<bool> m_binaryDefined;   // Formats written, by id.
+        std::mutex m_outputMutex;   // Guards m_history, m_console and the binary log.
+        std::unique_ptr<log_async_writer> m_async;
 
     };
 
     static const console_only_class console_only;
+    static const verbose_level_class verbose_level;
     static const informative_level_class informative_level;
     static const important_level_class important_level;
     static const error_level_class error_level;
@@ -122,4 +497,33 @@ namespace n88
 
 }  // namespace n88
 
+/** Logs a message if its level is enabled, without evaluating any of the
+  * arguments otherwise.
+  *
+  * @code
+  *   N88_LOG (log, n88::io::VERBOSE) << "Residual " << ComputeResidual() << "\n";
+  * @endcode
+  */
+#define N88_LOG(logger, level)                                              \
+    if (!(logger).IsEnabled (level)) {} else (logger).Message (level)
+
+/** Writes an event to the binary log of a logger, if the level is
+  * enabled.  The format is a string literal with a {} placeholder for each
+  * argument.
+  *
+  * @code
+  *   N88_LOG_BINARY (log, n88::io::VERBOSE, "Iteration {} residual {}", i, r);
+  * @endcode
+  */
+#define N88_LOG_BINARY(logger, level, format, ...)                          \
+    do                                                                      \
+    {                                                                       \
+      if ((logger).IsBinaryEnabled (level))                                 \
+      {                                                                     \
+        static const n88::io::binary_log_format n88_binary_log_format (format); \
+        (logger).LogBinary ((level), n88_binary_log_format, ##__VA_ARGS__);  \
+      }                                                                     \
+    }                                                                       \
+    while (0)
+
 #endif
@@ -0,0 +1,119 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_netcdf_chunk_shape_hpp_INCLUDED
+#define N88UTIL_netcdf_chunk_shape_hpp_INCLUDED
+
+// Chunk shape calculations for netcdf_chunking.hpp.  These do not call the
+// NetCDF library, so this header does not require netcdf.h.
+
+#include "n88util/tuplet.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace n88util
+{
+
+  /** The way in which a variable is expected to be read back. */
+  enum nc_access_pattern_t {
+    SLICE_ACCESS,   // Successive slabs along dimension 0 (e.g. nc_slab_reader).
+    BLOCK_ACCESS,   // Compact sub-blocks spanning all dimensions.
+    WHOLE_ACCESS    // The entire variable at once.
+  };
+
+  /** Default target size in bytes of one chunk. */
+  const size_t nc_default_chunk_bytes = size_t(4) << 20;
+
+  /** Returns x^n for small n. */
+  inline size_t ipow (size_t x, int n)
+  {
+    size_t p = 1;
+    for (int i=0; i<n; ++i)
+    { p *= x; }
+    return p;
+  }
+
+  /** Calculates a chunk shape suited to an access pattern.
+    *
+    * For SLICE_ACCESS, chunks are one entry thick along dimension 0 and span
+    * as much of the remaining dimensions as fits in chunk_bytes.  For
+    * BLOCK_ACCESS, chunks are as close to cubic as the dims allow.  For
+    * WHOLE_ACCESS, chunks are as many whole rows along dimension 0 as fit
+    * (only relevant if the variable is compressed; otherwise contiguous
+    * storage is better).
+    *
+    * @param dims  The dimensions of the variable.
+    * @param value_size  The size in bytes of one entry.
+    * @param access  The expected access pattern.
+    * @param chunk_bytes  Target size in bytes of one chunk.
+    */
+  template <int N>
+  n88::tuplet<N,size_t> nc_chunk_shape (n88::tuplet<N,size_t> dims,
+                                        size_t value_size,
+                                        nc_access_pattern_t access,
+                                        size_t chunk_bytes = nc_default_chunk_bytes)
+  {
+    const size_t target = std::max (chunk_bytes / std::max (value_size, size_t(1)), size_t(1));
+    n88::tuplet<N,size_t> chunks;
+    for (int i=0; i<N; ++i)
+    { chunks[i] = std::max (dims[i], size_t(1)); }
+    if (access == BLOCK_ACCESS)
+    {
+      // Start with a cube and let dimensions that are too short donate
+      // their share to the others.
+      size_t remaining = target;
+      int free_dims = N;
+      bool changed = true;
+      bool fixed[N];
+      for (int i=0; i<N; ++i)
+      { fixed[i] = false; }
+      while (changed && free_dims > 0)
+      {
+        changed = false;
+        const double edge = std::pow (double(remaining), 1.0/free_dims);
+        for (int i=0; i<N; ++i)
+        {
+          if (!fixed[i] && double(chunks[i]) <= edge)
+          {
+            fixed[i] = true;
+            remaining = std::max (remaining / chunks[i], size_t(1));
+            --free_dims;
+            changed = true;
+          }
+        }
+      }
+      if (free_dims > 0)
+      {
+        size_t edge = std::max (size_t(std::pow (double(remaining), 1.0/free_dims)), size_t(1));
+        // pow may fall just short of an exact root (e.g. 63.999... for 64^3).
+        while (ipow (edge + 1, free_dims) <= remaining)
+        { ++edge; }
+        for (int i=0; i<N; ++i)
+        {
+          if (!fixed[i])
+          { chunks[i] = std::min (chunks[i], edge); }
+        }
+      }
+    }
+    else
+    {
+      if (access == SLICE_ACCESS)
+      { chunks[0] = 1; }
+      // Shrink the slowest-changing dimensions first, so that chunks stay
+      // contiguous in the fastest-changing dimensions.
+      for (int i=0; i<N; ++i)
+      {
+        const size_t total = n88::long_product (chunks);
+        if (total <= target)
+        { break; }
+        const size_t rest = total / chunks[i];
+        chunks[i] = std::max (target / std::max (rest, size_t(1)), size_t(1));
+      }
+    }
+    return chunks;
+  }
+
+}  // namespace n88util
+
+#endif
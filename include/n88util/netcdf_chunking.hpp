@@ -0,0 +1,100 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_netcdf_chunking_hpp_INCLUDED
+#define N88UTIL_netcdf_chunking_hpp_INCLUDED
+
+#include "n88util/netcdf_templated.hpp"
+#include "n88util/netcdf_chunk_shape.hpp"
+#include "n88util/array.hpp"
+#include "n88util/tuplet.hpp"
+#include <algorithm>
+
+namespace n88util
+{
+
+  /** Defines a variable with storage tuned for an access pattern.
+    *
+    * The variable is defined with a chunk shape from nc_chunk_shape, a
+    * chunk cache large enough to hold all the chunks touched by one slab of
+    * chunks along dimension 0, and optional compression.  If no compression
+    * is requested and access is WHOLE_ACCESS, contiguous storage is used.
+    *
+    * The file must be in NetCDF-4 format and in define mode.
+    *
+    * Example:
+    * @code
+    *   int varid;
+    *   status = n88util::nc_def_array_var<float> (ncid, "density", dimids,
+    *               density.dims(), &varid, n88util::SLICE_ACCESS, 4);
+    * @endcode
+    *
+    * @param ncid  The NetCDF file id.
+    * @param name  The variable name.
+    * @param dimids  The N dimension ids, which must match dims.
+    * @param dims  The dimensions of the variable.
+    * @param varidp  Returns the id of the new variable.
+    * @param access  The expected access pattern for reading.
+    * @param deflate_level  0 for no compression, or 1 to 9.  The shuffle
+    *                       filter is also enabled for multi-byte types.
+    * @param chunk_bytes  Target size in bytes of one chunk.
+    * @return A NetCDF status code.
+    */
+  template <typename T, int N>
+  int nc_def_array_var (int ncid,
+                        const char* name,
+                        const int* dimids,
+                        n88::tuplet<N,size_t> dims,
+                        int* varidp,
+                        nc_access_pattern_t access = SLICE_ACCESS,
+                        int deflate_level = 0,
+                        size_t chunk_bytes = nc_default_chunk_bytes)
+  {
+    int status = ::nc_def_var (ncid, name, nc_traits<T>::type, N, dimids, varidp);
+    if (status != NC_NOERR)
+    { return status; }
+    if (access == WHOLE_ACCESS && deflate_level == 0)
+    { return nc_def_var_chunking (ncid, *varidp, NC_CONTIGUOUS, NULL); }
+    n88::tuplet<N,size_t> chunks = nc_chunk_shape (dims, sizeof(T), access, chunk_bytes);
+    status = nc_def_var_chunking (ncid, *varidp, NC_CHUNKED, chunks.data());
+    if (status != NC_NOERR)
+    { return status; }
+    if (deflate_level > 0)
+    {
+      const int shuffle = sizeof(T) > 1 ? 1 : 0;
+      status = nc_def_var_deflate (ncid, *varidp, shuffle, 1, deflate_level);
+      if (status != NC_NOERR)
+      { return status; }
+    }
+    // Chunks needed to cover one layer of chunks along dimension 0.
+    size_t layer_chunks = 1;
+    for (int i=1; i<N; ++i)
+    { layer_chunks *= (std::max (dims[i], size_t(1)) + chunks[i] - 1) / chunks[i]; }
+    const size_t chunk_size = n88::long_product (chunks) * sizeof(T);
+    const size_t cache_bytes = std::max (layer_chunks * chunk_size, size_t(32) << 20);
+    // Use plenty of hash slots relative to the number of cached chunks.
+    const size_t slots = std::max (layer_chunks * 10, size_t(1009));
+    return nc_set_var_chunk_cache (ncid, *varidp, cache_bytes, slots, 0.75f);
+  }
+
+  /** Version that takes the dimensions and type from an array. */
+  template <int N, typename T, typename TIndex>
+  int nc_def_array_var (int ncid,
+                        const char* name,
+                        const int* dimids,
+                        const n88::array_base<N,T,TIndex>& a,
+                        int* varidp,
+                        nc_access_pattern_t access = SLICE_ACCESS,
+                        int deflate_level = 0,
+                        size_t chunk_bytes = nc_default_chunk_bytes)
+  {
+    n88::tuplet<N,size_t> dims;
+    for (int i=0; i<N; ++i)
+    { dims[i] = a.dims()[i]; }
+    return nc_def_array_var<T,N> (ncid, name, dimids, dims, varidp,
+                                  access, deflate_level, chunk_bytes);
+  }
+
+}  // namespace n88util
+
+#endif
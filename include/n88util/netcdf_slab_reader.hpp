@@ -0,0 +1,216 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_netcdf_slab_reader_hpp_INCLUDED
+#define N88UTIL_netcdf_slab_reader_hpp_INCLUDED
+
+#include "n88util/netcdf_templated.hpp"
+#include "n88util/const_array.hpp"
+#include "n88util/array.hpp"
+#include "n88util/exception.hpp"
+#include <boost/noncopyable.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <algorithm>
+
+namespace n88util
+{
+
+  /** Reads a NetCDF variable as a sequence of slabs along its first
+    * (slowest-changing) dimension.
+    *
+    * This is intended for variables that are too large to read in one go
+    * with nc_get_var.  Each slab is thickness entries along dimension 0 and
+    * the full extent of the remaining dimensions; the last slab may be
+    * thinner.  Slabs are returned as const_array views into one of two
+    * internal buffers, so memory use is constant regardless of the size of
+    * the variable.
+    *
+    * While the caller processes one slab, a background thread reads the
+    * next slab into the other buffer.  The view returned by next is valid
+    * until the following call to next (or until the reader is destroyed).
+    *
+    * Note that the NetCDF library is not thread-safe, even for different
+    * files: while a reader exists, its background thread may be calling
+    * the library, so no other thread, including the caller, may call any
+    * NetCDF function on any file.
+    *
+    * Example:
+    * @code
+    *   n88util::nc_slab_reader<3,float> reader (ncid, varid);
+    *   n88::const_array<3,float> slab;
+    *   while (reader.next (slab))
+    *   {
+    *     // process slab, which starts at z = reader.position()
+    *   }
+    * @endcode
+    */
+  template <int N, typename T>
+  class nc_slab_reader : private boost::noncopyable
+  {
+    public:
+
+      /** Constructor.  Starts reading the first slab immediately.
+        *
+        * @param ncid  The NetCDF file id.
+        * @param varid  The id of the variable to read; it must have N dimensions.
+        * @param thickness  Number of entries along dimension 0 per slab.
+        */
+      nc_slab_reader (int ncid, int varid, size_t thickness = 1)
+        :
+        m_ncid (ncid),
+        m_varid (varid),
+        m_thickness (thickness),
+        m_next (0),
+        m_held (-1),
+        m_position (0),
+        m_cancel (false)
+      {
+        n88_assert (thickness > 0);
+        int ndims = 0;
+        check (nc_inq_varndims (ncid, varid, &ndims));
+        if (ndims != N)
+        { throw_n88_exception ("NetCDF variable has wrong number of dimensions."); }
+        int dimids[N];
+        check (nc_inq_vardimid (ncid, varid, dimids));
+        for (int i=0; i<N; ++i)
+        { check (nc_inq_dimlen (ncid, dimids[i], &this->m_dims[i])); }
+        this->m_slabs = (this->m_dims[0] + thickness - 1) / thickness;
+        n88::tuplet<N,size_t> buffer_dims = this->m_dims;
+        buffer_dims[0] = std::min (thickness, this->m_dims[0]);
+        for (int b=0; b<2; ++b)
+        {
+          this->m_ready[b] = false;
+          this->m_status[b] = NC_NOERR;
+          if (this->m_slabs > 0)
+          { this->m_buffers[b].construct (buffer_dims); }
+        }
+        this->m_thread = std::thread (&nc_slab_reader::read_loop, this);
+      }
+
+      ~nc_slab_reader ()
+      {
+        {
+          std::lock_guard<std::mutex> lock (this->m_mutex);
+          this->m_cancel = true;
+        }
+        this->m_changed.notify_all();
+        this->m_thread.join();
+      }
+
+      /** Makes the next slab available.
+        *
+        * Blocks only if the background thread has not yet finished reading
+        * the slab.  Throws an exception if reading failed.
+        *
+        * @param slab  Set to reference the next slab.
+        * @return false if there are no more slabs (slab is then unconstructed).
+        */
+      bool next (n88::const_array_base<N,T>& slab)
+      {
+        slab.destruct();
+        std::unique_lock<std::mutex> lock (this->m_mutex);
+        if (this->m_held >= 0)
+        {
+          this->m_ready[this->m_held] = false;
+          this->m_held = -1;
+          this->m_changed.notify_all();
+        }
+        if (this->m_next >= this->m_slabs)
+        { return false; }
+        const int b = int(this->m_next % 2);
+        while (!this->m_ready[b])
+        { this->m_changed.wait (lock); }
+        if (this->m_status[b] != NC_NOERR)
+        { check (this->m_status[b]); }
+        this->m_held = b;
+        this->m_position = this->m_next * this->m_thickness;
+        ++this->m_next;
+        n88::tuplet<N,size_t> slab_dims = this->m_dims;
+        slab_dims[0] = slab_count (this->m_position);
+        slab.construct_reference (this->m_buffers[b].data(), slab_dims);
+        return true;
+      }
+
+      /** Returns the index along dimension 0 at which the most recently
+        * returned slab starts.
+        */
+      size_t position () const
+      { return this->m_position; }
+
+      /** Returns the dimensions of the entire variable. */
+      n88::tuplet<N,size_t> dims () const
+      { return this->m_dims; }
+
+      /** Returns the total number of slabs. */
+      size_t number_of_slabs () const
+      { return this->m_slabs; }
+
+    protected:
+
+      static void check (int status)
+      {
+        if (status != NC_NOERR)
+        { throw_n88_exception (std::string ("NetCDF error: ") + nc_strerror (status)); }
+      }
+
+      size_t slab_count (size_t start) const
+      { return std::min (this->m_thickness, this->m_dims[0] - start); }
+
+      void read_loop ()
+      {
+        for (size_t k=0; k<this->m_slabs; ++k)
+        {
+          const int b = int(k % 2);
+          {
+            std::unique_lock<std::mutex> lock (this->m_mutex);
+            while (!this->m_cancel && this->m_ready[b])
+            { this->m_changed.wait (lock); }
+            if (this->m_cancel)
+            { return; }
+          }
+          size_t start[N];
+          size_t count[N];
+          for (int i=0; i<N; ++i)
+          {
+            start[i] = 0;
+            count[i] = this->m_dims[i];
+          }
+          start[0] = k * this->m_thickness;
+          count[0] = slab_count (start[0]);
+          const int status = nc_get_vara<T> (this->m_ncid, this->m_varid,
+                                             start, count, this->m_buffers[b].data());
+          {
+            std::lock_guard<std::mutex> lock (this->m_mutex);
+            this->m_status[b] = status;
+            this->m_ready[b] = true;
+          }
+          this->m_changed.notify_all();
+          if (status != NC_NOERR)
+          { return; }
+        }
+      }
+
+      int m_ncid;
+      int m_varid;
+      size_t m_thickness;
+      size_t m_slabs;
+      n88::tuplet<N,size_t> m_dims;
+      n88::array_base<N,T> m_buffers[2];
+      bool m_ready[2];
+      int m_status[2];
+      size_t m_next;        // Index of next slab to be returned by next().
+      int m_held;           // Buffer currently held by the caller, or -1.
+      size_t m_position;
+      bool m_cancel;
+      std::mutex m_mutex;
+      std::condition_variable m_changed;
+      std::thread m_thread;
+
+  };
+
+}  // namespace n88util
+
+#endif
@@ -0,0 +1,250 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_netcdf_slab_writer_hpp_INCLUDED
+#define N88UTIL_netcdf_slab_writer_hpp_INCLUDED
+
+#include "n88util/netcdf_templated.hpp"
+#include "n88util/const_array.hpp"
+#include "n88util/exception.hpp"
+#include <boost/noncopyable.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <utility>
+
+namespace n88util
+{
+
+  /** Writes hyperslabs of a NetCDF variable asynchronously.
+    *
+    * Each slab passed to put is copied into an internal buffer and written
+    * with nc_put_vara by a background thread, so that the caller can carry
+    * on computing while output proceeds.  At most max_queued slabs are
+    * held at once; put blocks if the queue is full.  Buffers are recycled,
+    * so once the queue has filled no further allocations occur for slabs of
+    * the same size.
+    *
+    * Errors from the NetCDF library are reported by throwing an exception
+    * from the next call to put or flush.
+    *
+    * Note that the NetCDF library is not thread-safe, even for different
+    * files: from the first call to put until flush returns, the background
+    * thread may be calling the library, so no other thread, including the
+    * caller, may call any NetCDF function on any file.
+    *
+    * Example:
+    * @code
+    *   n88util::nc_slab_writer<3,float> writer (ncid, varid);
+    *   for (size_t z=0; z<nz; ++z)
+    *   {
+    *     // compute slice z into slab (dims 1 x ny x nx)
+    *     writer.put (slab, z);
+    *   }
+    *   writer.flush();
+    * @endcode
+    */
+  template <int N, typename T>
+  class nc_slab_writer : private boost::noncopyable
+  {
+    public:
+
+      /** Constructor.
+        *
+        * @param ncid  The NetCDF file id.
+        * @param varid  The id of the variable to write; it must have N dimensions.
+        * @param max_queued  Maximum number of slabs held waiting to be written.
+        */
+      nc_slab_writer (int ncid, int varid, size_t max_queued = 2)
+        :
+        m_ncid (ncid),
+        m_varid (varid),
+        m_max_queued (max_queued),
+        m_reserved (0),
+        m_busy (false),
+        m_written (0),
+        m_status (NC_NOERR),
+        m_stop (false)
+      {
+        n88_assert (max_queued > 0);
+        this->m_thread = std::thread (&nc_slab_writer::write_loop, this);
+      }
+
+      /** Destructor.  Waits for all queued slabs to be written.  Errors are
+        * ignored; call flush first if you need to know about them.
+        */
+      ~nc_slab_writer ()
+      {
+        {
+          std::unique_lock<std::mutex> lock (this->m_mutex);
+          this->wait_idle (lock);
+          this->m_stop = true;
+        }
+        this->m_changed.notify_all();
+        this->m_thread.join();
+      }
+
+      /** Queues a slab to be written at an arbitrary position.
+        *
+        * The extent of the hyperslab is given by the dims of slab.
+        *
+        * @param slab  The data to write.  It is copied, so may be modified
+        *              as soon as put returns.
+        * @param start  The index in the variable of the first entry of slab.
+        */
+      void put (const n88::const_array_base<N,T>& slab, n88::tuplet<N,size_t> start)
+      {
+        std::unique_lock<std::mutex> lock (this->m_mutex);
+        while (this->m_status == NC_NOERR
+               && this->m_queue.size() + this->m_reserved >= this->m_max_queued)
+        { this->m_changed.wait (lock); }
+        this->check_status();
+        // Hold a place in the queue while copying, so that other callers
+        // of put cannot exceed max_queued.
+        ++this->m_reserved;
+        slab_t s;
+        if (!this->m_free.empty())
+        {
+          s.data = std::move (this->m_free.back());
+          this->m_free.pop_back();
+        }
+        lock.unlock();
+        // Copy outside the lock so that the writer thread is not held up.
+        s.data.resize (slab.size());
+        if (slab.size())
+        { memcpy (&s.data[0], slab.data(), slab.size()*sizeof(T)); }
+        for (int i=0; i<N; ++i)
+        {
+          s.start[i] = start[i];
+          s.count[i] = slab.dims()[i];
+        }
+        lock.lock();
+        --this->m_reserved;
+        if (this->m_status != NC_NOERR)
+        {
+          // A write failed while copying; the queue has been discarded.
+          this->m_free.push_back (std::move (s.data));
+          this->m_changed.notify_all();
+          this->check_status();
+        }
+        this->m_queue.push_back (std::move (s));
+        lock.unlock();
+        this->m_changed.notify_all();
+      }
+
+      /** Queues a slab to be written along dimension 0.
+        *
+        * @param slab  The data to write.  Its dims other than dimension 0 must
+        *              be the full extent of the variable.
+        * @param position  The index along dimension 0 of the start of slab.
+        */
+      void put (const n88::const_array_base<N,T>& slab, size_t position)
+      {
+        n88::tuplet<N,size_t> start = n88::tuplet<N,size_t>::zeros();
+        start[0] = position;
+        this->put (slab, start);
+      }
+
+      /** Blocks until all queued slabs have been written.
+        * Throws an exception if any write failed.
+        */
+      void flush ()
+      {
+        std::unique_lock<std::mutex> lock (this->m_mutex);
+        this->wait_idle (lock);
+        this->check_status();
+      }
+
+      /** Returns the number of slabs that have been successfully written. */
+      size_t written ()
+      {
+        std::lock_guard<std::mutex> lock (this->m_mutex);
+        return this->m_written;
+      }
+
+      /** Returns the number of slabs queued or currently being written. */
+      size_t pending ()
+      {
+        std::lock_guard<std::mutex> lock (this->m_mutex);
+        return this->m_queue.size() + (this->m_busy ? 1 : 0);
+      }
+
+    protected:
+
+      struct slab_t
+      {
+        std::vector<T> data;
+        size_t start[N];
+        size_t count[N];
+      };
+
+      void check_status ()
+      {
+        if (this->m_status != NC_NOERR)
+        {
+          throw_n88_exception (std::string ("NetCDF error: ")
+                               + nc_strerror (this->m_status));
+        }
+      }
+
+      void wait_idle (std::unique_lock<std::mutex>& lock)
+      {
+        while (this->m_status == NC_NOERR
+               && (this->m_busy || this->m_reserved > 0 || !this->m_queue.empty()))
+        { this->m_changed.wait (lock); }
+      }
+
+      void write_loop ()
+      {
+        std::unique_lock<std::mutex> lock (this->m_mutex);
+        while (true)
+        {
+          while (!this->m_stop && this->m_queue.empty())
+          { this->m_changed.wait (lock); }
+          if (this->m_queue.empty())
+          { return; }
+          slab_t s = std::move (this->m_queue.front());
+          this->m_queue.pop_front();
+          this->m_busy = true;
+          lock.unlock();
+          const int status = nc_put_vara<T> (this->m_ncid, this->m_varid,
+                                             s.start, s.count,
+                                             s.data.empty() ? NULL : &s.data[0]);
+          lock.lock();
+          this->m_busy = false;
+          if (status == NC_NOERR)
+          { ++this->m_written; }
+          else
+          {
+            // Discard anything remaining; the caller will get an exception.
+            this->m_status = status;
+            this->m_queue.clear();
+          }
+          this->m_free.push_back (std::move (s.data));
+          this->m_changed.notify_all();
+        }
+      }
+
+      int m_ncid;
+      int m_varid;
+      size_t m_max_queued;
+      std::deque<slab_t> m_queue;
+      std::vector<std::vector<T> > m_free;   // Recycled slab buffers.
+      size_t m_reserved;                      // Slabs being copied by put.
+      bool m_busy;
+      size_t m_written;
+      int m_status;
+      bool m_stop;
+      std::mutex m_mutex;
+      std::condition_variable m_changed;
+      std::thread m_thread;
+
+  };
+
+}  // namespace n88util
+
+#endif
@@ -5,81 +5,142 @@
 #define N88UTIL_netcdf_templated_hpp_INCLUDED
 
 #include <netcdf.h>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/conditional.hpp>
+#include <cstddef>
 
 namespace n88util
 {
 
-  template <typename T> int nc_get_var (int ncid, int varid, T* p);
-  template <typename T> int nc_get_var1 (int ncid, int varid, const size_t *indexp, T* p);
-  template <typename T> int nc_get_vara (int ncid, int varid, const size_t *startp, const size_t *countp, T* p);
-  template <typename T> int nc_put_var (int ncid, int varid, const T* p);
-
-  template <> int nc_get_var<unsigned char> (int ncid, int varid, unsigned char* p)
-  { return nc_get_var_uchar (ncid, varid, p); }
-  template <> int nc_get_var<int> (int ncid, int varid, int* p)
-  { return nc_get_var_int (ncid, varid, p); }
-  template <> int nc_get_var<unsigned int> (int ncid, int varid, unsigned int* p)
-  { return nc_get_var_uint (ncid, varid, p); }
-#ifdef WIN32
-  template <> int nc_get_var<unsigned long long> (int ncid, int varid, unsigned long long* p)
-  {
-    return nc_get_var_ulonglong (ncid, varid, (unsigned long long*)p);
-  }
-#else
-  template <> int nc_get_var<unsigned long> (int ncid, int varid, unsigned long* p)
-  {
-    BOOST_STATIC_ASSERT(sizeof(unsigned long) == sizeof(unsigned long long));
-    return nc_get_var_ulonglong (ncid, varid, (unsigned long long*)p);
-  }
-#endif
-  template <> int nc_get_var<float> (int ncid, int varid, float* p)
-  { return nc_get_var_float (ncid, varid, p); }
-  template <> int nc_get_var<double> (int ncid, int varid, double* p)
-  { return nc_get_var_double (ncid, varid, p); }
-
-  template <> int nc_get_var1<int> (int ncid, int varid, const size_t *indexp, int* p)
-  { return nc_get_var1_int (ncid, varid, indexp, p); }
-  template <> int nc_get_var1<unsigned int> (int ncid, int varid, const size_t *indexp, unsigned int* p)
-  { return nc_get_var1_uint (ncid, varid, indexp, p); }
-  template <> int nc_get_var1<float> (int ncid, int varid, const size_t *indexp, float* p)
-  { return nc_get_var1_float (ncid, varid, indexp, p); }
-  template <> int nc_get_var1<double> (int ncid, int varid, const size_t *indexp, double* p)
-  { return nc_get_var1_double (ncid, varid, indexp, p); }
-
-  template <> int nc_get_vara<float> (int ncid, int varid, const size_t *startp, const size_t *countp, float* p)
-  { return nc_get_vara_float (ncid, varid, startp, countp, p); }
-  template <> int nc_get_vara<double> (int ncid, int varid, const size_t *startp, const size_t *countp, double* p)
-  { return nc_get_vara_double (ncid, varid, startp, countp, p); }
-  template <> int nc_get_vara<long> (int ncid, int varid, const size_t *startp, const size_t *countp, long* p)
-  { return nc_get_vara_long (ncid, varid, startp, countp, p); }
-#ifdef WIN32
-  template <> int nc_get_vara<unsigned long> (int ncid, int varid, const size_t *startp, const size_t *countp, unsigned long* p)
-  {
-    BOOST_STATIC_ASSERT(sizeof(unsigned long) == sizeof(unsigned int));
-    return nc_get_vara_uint (ncid, varid, startp, countp, (unsigned int*)p);
-  }
-#else
-  template <> int nc_get_vara<unsigned long> (int ncid, int varid, const size_t *startp, const size_t *countp, unsigned long* p)
+  /** Maps a C++ type to its NetCDF external type and to the typed NetCDF
+    * functions.
+    *
+    * nc_traits is specialized for every numeric type that NetCDF can read
+    * into or write from directly (NetCDF converts to and from the external
+    * type of the variable as required).  It is deliberately left undefined
+    * for other types, so that using one is a compile-time error rather
+    * than a link-time error.
+    *
+    * All members are inline, so this header may be included in any number
+    * of translation units.
+    */
+  template <typename T> struct nc_traits;
+
+#define N88UTIL_NC_TRAITS(CTYPE, NCTYPE, SUFFIX)                                        \
+  template <> struct nc_traits<CTYPE>                                                   \
+  {                                                                                     \
+    static constexpr nc_type type = NCTYPE;                                             \
+    static int get_var (int ncid, int varid, CTYPE* p)                                  \
+    { return nc_get_var_##SUFFIX (ncid, varid, p); }                                    \
+    static int get_var1 (int ncid, int varid, const size_t* indexp, CTYPE* p)           \
+    { return nc_get_var1_##SUFFIX (ncid, varid, indexp, p); }                           \
+    static int get_vara (int ncid, int varid, const size_t* startp,                     \
+                         const size_t* countp, CTYPE* p)                                \
+    { return nc_get_vara_##SUFFIX (ncid, varid, startp, countp, p); }                   \
+    static int get_vars (int ncid, int varid, const size_t* startp,                     \
+                         const size_t* countp, const ptrdiff_t* stridep, CTYPE* p)      \
+    { return nc_get_vars_##SUFFIX (ncid, varid, startp, countp, stridep, p); }          \
+    static int put_var (int ncid, int varid, const CTYPE* p)                            \
+    { return nc_put_var_##SUFFIX (ncid, varid, p); }                                    \
+    static int put_var1 (int ncid, int varid, const size_t* indexp, const CTYPE* p)     \
+    { return nc_put_var1_##SUFFIX (ncid, varid, indexp, p); }                           \
+    static int put_vara (int ncid, int varid, const size_t* startp,                     \
+                         const size_t* countp, const CTYPE* p)                          \
+    { return nc_put_vara_##SUFFIX (ncid, varid, startp, countp, p); }                   \
+    static int put_vars (int ncid, int varid, const size_t* startp,                     \
+                         const size_t* countp, const ptrdiff_t* stridep, const CTYPE* p)\
+    { return nc_put_vars_##SUFFIX (ncid, varid, startp, countp, stridep, p); }          \
+  };
+
+  N88UTIL_NC_TRAITS(signed char, NC_BYTE, schar)
+  N88UTIL_NC_TRAITS(unsigned char, NC_UBYTE, uchar)
+  N88UTIL_NC_TRAITS(short, NC_SHORT, short)
+  N88UTIL_NC_TRAITS(unsigned short, NC_USHORT, ushort)
+  N88UTIL_NC_TRAITS(int, NC_INT, int)
+  N88UTIL_NC_TRAITS(unsigned int, NC_UINT, uint)
+  N88UTIL_NC_TRAITS(long long, NC_INT64, longlong)
+  N88UTIL_NC_TRAITS(unsigned long long, NC_UINT64, ulonglong)
+  N88UTIL_NC_TRAITS(float, NC_FLOAT, float)
+  N88UTIL_NC_TRAITS(double, NC_DOUBLE, double)
+
+#undef N88UTIL_NC_TRAITS
+
+  /** nc_traits for a type that NetCDF has no functions for, implemented by
+    * forwarding to the functions of a type with the same representation.
+    */
+  template <typename T, typename TImpl>
+  struct nc_forwarding_traits
   {
-    BOOST_STATIC_ASSERT(sizeof(unsigned long) == sizeof(unsigned long long));
-    return nc_get_vara_ulonglong (ncid, varid, startp, countp, (unsigned long long*)p);
-  }
-#endif
-  template <> int nc_get_vara<long long> (int ncid, int varid, const size_t *startp, const size_t *countp, long long* p)
-  { return nc_get_vara_longlong (ncid, varid, startp, countp, p); }
-  template <> int nc_get_vara<unsigned long long> (int ncid, int varid, const size_t *startp, const size_t *countp, unsigned long long* p)
-  { return nc_get_vara_ulonglong (ncid, varid, startp, countp, p); }
-
-  template <> int nc_put_var<unsigned char> (int ncid, int varid, const unsigned char* p)
-  { return nc_put_var_uchar (ncid, varid, p); }
-  template <> int nc_put_var<int> (int ncid, int varid, const int* p)
-  { return nc_put_var_int (ncid, varid, p); }
-  template <> int nc_put_var<unsigned int> (int ncid, int varid, const unsigned int* p)
-  { return nc_put_var_uint (ncid, varid, p); }
-  template <> int nc_put_var<float> (int ncid, int varid, const float* p)
-  { return nc_put_var_float (ncid, varid, p); }
-  template <> int nc_put_var<double> (int ncid, int varid, const double* p)
-  { return nc_put_var_double (ncid, varid, p); }
+    BOOST_STATIC_ASSERT(sizeof(T) == sizeof(TImpl));
+    static constexpr nc_type type = nc_traits<TImpl>::type;
+    static int get_var (int ncid, int varid, T* p)
+    { return nc_traits<TImpl>::get_var (ncid, varid, (TImpl*)p); }
+    static int get_var1 (int ncid, int varid, const size_t* indexp, T* p)
+    { return nc_traits<TImpl>::get_var1 (ncid, varid, indexp, (TImpl*)p); }
+    static int get_vara (int ncid, int varid, const size_t* startp,
+                         const size_t* countp, T* p)
+    { return nc_traits<TImpl>::get_vara (ncid, varid, startp, countp, (TImpl*)p); }
+    static int get_vars (int ncid, int varid, const size_t* startp,
+                         const size_t* countp, const ptrdiff_t* stridep, T* p)
+    { return nc_traits<TImpl>::get_vars (ncid, varid, startp, countp, stridep, (TImpl*)p); }
+    static int put_var (int ncid, int varid, const T* p)
+    { return nc_traits<TImpl>::put_var (ncid, varid, (const TImpl*)p); }
+    static int put_var1 (int ncid, int varid, const size_t* indexp, const T* p)
+    { return nc_traits<TImpl>::put_var1 (ncid, varid, indexp, (const TImpl*)p); }
+    static int put_vara (int ncid, int varid, const size_t* startp,
+                         const size_t* countp, const T* p)
+    { return nc_traits<TImpl>::put_vara (ncid, varid, startp, countp, (const TImpl*)p); }
+    static int put_vars (int ncid, int varid, const size_t* startp,
+                         const size_t* countp, const ptrdiff_t* stridep, const T* p)
+    { return nc_traits<TImpl>::put_vars (ncid, varid, startp, countp, stridep, (const TImpl*)p); }
+  };
+
+  // long and unsigned long are 32 bit on Windows and 64 bit elsewhere.
+  template <> struct nc_traits<long>
+    : nc_forwarding_traits<long,
+        boost::conditional<sizeof(long) == sizeof(long long), long long, int>::type>
+  {};
+  template <> struct nc_traits<unsigned long>
+    : nc_forwarding_traits<unsigned long,
+        boost::conditional<sizeof(unsigned long) == sizeof(unsigned long long),
+                           unsigned long long, unsigned int>::type>
+  {};
+
+  // Convenience functions that dispatch on the type of the data pointer.
+
+  template <typename T>
+  inline int nc_get_var (int ncid, int varid, T* p)
+  { return nc_traits<T>::get_var (ncid, varid, p); }
+
+  template <typename T>
+  inline int nc_get_var1 (int ncid, int varid, const size_t *indexp, T* p)
+  { return nc_traits<T>::get_var1 (ncid, varid, indexp, p); }
+
+  template <typename T>
+  inline int nc_get_vara (int ncid, int varid, const size_t *startp, const size_t *countp, T* p)
+  { return nc_traits<T>::get_vara (ncid, varid, startp, countp, p); }
+
+  template <typename T>
+  inline int nc_get_vars (int ncid, int varid, const size_t *startp, const size_t *countp,
+                          const ptrdiff_t *stridep, T* p)
+  { return nc_traits<T>::get_vars (ncid, varid, startp, countp, stridep, p); }
+
+  template <typename T>
+  inline int nc_put_var (int ncid, int varid, const T* p)
+  { return nc_traits<T>::put_var (ncid, varid, p); }
+
+  template <typename T>
+  inline int nc_put_var1 (int ncid, int varid, const size_t *indexp, const T* p)
+  { return nc_traits<T>::put_var1 (ncid, varid, indexp, p); }
+
+  template <typename T>
+  inline int nc_put_vara (int ncid, int varid, const size_t *startp, const size_t *countp, const T* p)
+  { return nc_traits<T>::put_vara (ncid, varid, startp, countp, p); }
+
+  template <typename T>
+  inline int nc_put_vars (int ncid, int varid, const size_t *startp, const size_t *countp,
+                          const ptrdiff_t *stridep, const T* p)
+  { return nc_traits<T>::put_vars (ncid, varid, startp, countp, stridep, p); }
 
 }  // namespace n88util
 
@@ -0,0 +1,166 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#ifndef N88UTIL_profiler_hpp_INCLUDED
+#define N88UTIL_profiler_hpp_INCLUDED
+
+#include "n88util_export.h"
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace n88
+{
+
+  /** The clock used by the profiler, in nanoseconds.
+    *
+    * This is the same clock as TimeStamp::WALL.
+    */
+  inline int64_t profiler_clock ()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** Collects timings of nested code regions.
+    *
+    * Regions are marked with N88_PROFILE_SCOPE, which times the rest of
+    * the enclosing block:
+    *
+    *   void solve ()
+    *   {
+    *     N88_PROFILE_SCOPE ("solve");
+    *     ...
+    *   }
+    *
+    * Each thread has its own stack of active regions, and timings are
+    * accumulated separately for each path of nested regions (so "solve"
+    * called from "step" is distinct from "solve" called from "setup").
+    * For each path, the number of calls and the total, self (i.e.
+    * excluding nested regions), minimum and maximum times are recorded.
+    * Report combines the threads, including those that have exited.
+    *
+    * Profiling is disabled by default.  When disabled, a region costs
+    * only a test of a flag.
+    *
+    * If tracing is also enabled, each call is recorded as an event, which
+    * WriteChromeTrace writes in the Chrome trace event format (for
+    * chrome://tracing or Perfetto).
+    *
+    * If counters are enabled, hardware performance counters (cycles,
+    * instructions and last level cache misses) are also read at the
+    * start and end of each region, and Report includes the instructions
+    * per cycle and the memory bandwidth estimated from the cache misses.
+    * This requires Linux perf events; reading the counters costs a system
+    * call at each region boundary.
+    */
+  class N88UTIL_EXPORT profiler : private boost::noncopyable
+  {
+    public:
+
+      static void SetEnabled (bool enabled)
+      { m_enabled.store (enabled, std::memory_order_relaxed); }
+
+      static bool IsEnabled ()
+      { return m_enabled.load (std::memory_order_relaxed); }
+
+      /** Enables recording of events for WriteChromeTrace.  At most
+        * maxEvents events are recorded for each thread; later ones are
+        * dropped.  Tracing has no effect unless profiling is enabled.
+        */
+      static void SetTraceEnabled (bool enabled, size_t maxEvents = 1000000);
+
+      static bool GetTraceEnabled ();
+
+      /** Enables reading of hardware performance counters.  Returns false,
+        * and leaves counters disabled, if they are not available (e.g.
+        * not Linux, or access is restricted by perf_event_paranoid).
+        * Threads on which the counters cannot be opened are timed
+        * without them.
+        */
+      static bool SetCountersEnabled (bool enabled);
+
+      static bool GetCountersEnabled ();
+
+      /** Writes a table of all regions, nested by path, to out. */
+      static void Report (std::ostream& out);
+
+      /** Writes the recorded events as Chrome trace JSON to out. */
+      static void WriteChromeTrace (std::ostream& out);
+
+      /** Discards all timings and events.  Regions that are active
+        * continue to be timed.
+        */
+      static void Reset ();
+
+    protected:
+
+      static std::atomic<bool> m_enabled;
+  };
+
+  /** A named region, identified by a small integer.
+    *
+    * There should be a single profile_region for each region name, which
+    * is normally a static at the point of use, as with N88_PROFILE_SCOPE.
+    */
+  class N88UTIL_EXPORT profile_region : private boost::noncopyable
+  {
+    public:
+
+      /** name must be a string literal or otherwise outlive the profiler. */
+      explicit profile_region (const char* name);
+
+      const char* name () const
+      { return this->m_name; }
+
+      uint32_t id () const
+      { return this->m_id; }
+
+    protected:
+
+      const char* m_name;
+      uint32_t m_id;
+  };
+
+  /** Times a region from construction to destruction. */
+  class N88UTIL_EXPORT profile_scope : private boost::noncopyable
+  {
+    public:
+
+      explicit profile_scope (const profile_region& region)
+        :
+        m_active (false)
+      {
+        if (profiler::IsEnabled())
+        { this->Enter (region); }
+      }
+
+      ~profile_scope ()
+      {
+        if (this->m_active)
+        { this->Exit(); }
+      }
+
+    protected:
+
+      void Enter (const profile_region& region);
+      void Exit ();
+
+      bool m_active;
+  };
+
+}  // namespace n88
+
+#define N88_PROFILE_CONCAT_(a, b) a##b
+#define N88_PROFILE_CONCAT(a, b) N88_PROFILE_CONCAT_(a, b)
+
+/** Profiles the rest of the enclosing block as a region called name,
+  * which must be a string literal.
+  */
+#define N88_PROFILE_SCOPE(name) \
+  static const n88::profile_region N88_PROFILE_CONCAT(n88_profile_region_, __LINE__) (name); \
+  n88::profile_scope N88_PROFILE_CONCAT(n88_profile_scope_, __LINE__) (N88_PROFILE_CONCAT(n88_profile_region_, __LINE__))
+
+#endif
@@ -15,11 +15,103 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include "n88util_export.h"
 
 namespace n88util
 {
 
+  /** \brief A set of separator characters.
+   *
+   * Membership is tested by table lookup.  Construct once and reuse when
+   * splitting many strings with the same separators.
+   *
+   * find_first and find_first_not classify 16 or 32 characters at a time
+   * with SIMD instructions where the CPU supports them, provided that all
+   * the separators are ASCII characters.
+   */
+  class N88UTIL_EXPORT separator_set
+  {
+    public:
+
+      explicit separator_set(const char* separators);
+
+      /** Returns true if c is a separator. */
+      bool contains(char c) const
+      { return this->m_table[(unsigned char)c]; }
+
+      /** Returns a pointer to the first separator in [begin,end), or end
+       *  if there is none.
+       */
+      const char* find_first(const char* begin, const char* end) const;
+
+      /** Returns a pointer to the first character in [begin,end) that is
+       *  not a separator, or end if there is none.
+       */
+      const char* find_first_not(const char* begin, const char* end) const;
+
+    protected:
+
+      bool m_table[256];
+      // For each value of the low nibble of a character, a bit mask of the
+      // values of the high nibble for which it is a separator.
+      unsigned char m_nibble_table[16];
+      bool m_ascii;   // True if all separators are < 0x80.
+  };
+
+  /** \brief Returns s with whitespace removed from both ends. */
+  N88UTIL_EXPORT std::string_view trim(std::string_view s);
+
+  /** \brief Calls f(std::string_view) for each token in s.
+   *
+   * Repeated tokens are treated as one.  Tokens reference s, so no memory
+   * is allocated.
+   */
+  template <typename F>
+  void for_each_argument(std::string_view s, const separator_set& separators, F f)
+    {
+    const char* p = s.data();
+    const char* const end = p + s.size();
+    while (true)
+      {
+      p = separators.find_first_not(p, end);
+      if (p == end)
+        {
+        break;
+        }
+      const char* q = separators.find_first(p, end);
+      f(std::string_view(p, q - p));
+      p = q;
+      }
+    }
+
+  /** \brief Calls f(std::string_view) for each token in s.
+   *
+   * Repeated tokens are NOT treated as one.  The tokens are trimmed of
+   * whitespace on both sides.  Tokens reference s, so no memory is
+   * allocated.
+   */
+  template <typename F>
+  void for_each_trimmed(std::string_view s, const separator_set& separators, F f)
+    {
+    if (s.empty())
+      {
+      return;
+      }
+    const char* p = s.data();
+    const char* const end = p + s.size();
+    while (true)
+      {
+      const char* q = separators.find_first(p, end);
+      f(trim(std::string_view(p, q - p)));
+      if (q == end)
+        {
+        break;
+        }
+      p = q + 1;
+      }
+    }
+
   /** \brief Splits a string into tokens.
    *
    * Repeated tokens are treated as one.
@@ -37,6 +129,34 @@ namespace n88util
                   std::vector<std::string>& tokens,
                   const char* separators = NULL);
 
+  /** \brief Version that returns views into s.
+   *
+   * tokens is cleared first; if it has sufficient capacity, no memory is
+   * allocated.  The tokens are valid only as long as s is.
+   */
+  N88UTIL_EXPORT void split_arguments(std::string_view s,
+                       std::vector<std::string_view>& tokens,
+                       const char* separators = NULL);
+
+  /** \brief Version that returns views into s, with precomputed separators. */
+  N88UTIL_EXPORT void split_arguments(std::string_view s,
+                       std::vector<std::string_view>& tokens,
+                       const separator_set& separators);
+
+  /** \brief Version that returns views into s.
+   *
+   * tokens is cleared first; if it has sufficient capacity, no memory is
+   * allocated.  The tokens are valid only as long as s is.
+   */
+  N88UTIL_EXPORT void split_trim(std::string_view s,
+                  std::vector<std::string_view>& tokens,
+                  const char* separators = NULL);
+
+  /** \brief Version that returns views into s, with precomputed separators. */
+  N88UTIL_EXPORT void split_trim(std::string_view s,
+                  std::vector<std::string_view>& tokens,
+                  const separator_set& separators);
+
 }   // namespace n88util
 
 #endif  // #ifndef __n88util_text_h
@@ -3,66 +3,610 @@
 
 #include "n88util/TrackingAllocator.hpp"
 #include "n88util/exception.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__linux__) || defined(__APPLE__)
+#include <dlfcn.h>
+#define N88_HAVE_DLADDR
+#endif
 
 namespace n88
 {
 
-  boost::thread_specific_ptr<TrackingAllocatorValues> TrackingAllocator::allocated;
-
-  void* TrackingAllocator::allocate(size_t size)
+  namespace
   {
-    void* p = malloc(size);
-    if (p)
+    std::atomic<int64_t> global_current (0);
+    std::atomic<int64_t> global_peak (0);
+    std::atomic<size_t> global_count (0);
+
+    struct thread_values : TrackingAllocatorValues
+    {
+      // Set when the thread_exit for this thread has been created.
+      bool registered;
+      // Set when the thread is exiting, after which changes are merged
+      // immediately.
+      bool exiting;
+    };
+
+    // Trivially constructible and destructible, so is zero initialized
+    // and accessed without any guard, and remains usable while other
+    // thread_local objects are destroyed.
+    thread_local thread_values this_thread_values;
+
+    void merge (TrackingAllocatorValues& v)
+    {
+      if (v.pending != 0)
+      {
+        const int64_t current = global_current.fetch_add (v.pending, std::memory_order_relaxed) + v.pending;
+        int64_t peak = global_peak.load (std::memory_order_relaxed);
+        while (current > peak
+               && !global_peak.compare_exchange_weak (peak, current, std::memory_order_relaxed))
+        {}
+        v.pending = 0;
+      }
+      if (v.pending_count != 0)
+      {
+        global_count.fetch_add (v.pending_count, std::memory_order_relaxed);
+        v.pending_count = 0;
+      }
+    }
+
+    // Merges the changes of a thread when it exits.
+    struct thread_exit
+    {
+      ~thread_exit()
+      {
+        this_thread_values.exiting = true;
+        merge (this_thread_values);
+      }
+    };
+
+    thread_local thread_exit this_thread_exit;
+
+    // Each allocation is immediately preceded by a header.  Ordinarily the
+    // header is at the start of the block, padded to keep the alignment
+    // given by malloc; for greater alignments it is placed before the
+    // first aligned address after it.
+    struct allocation_header
+    {
+      uint32_t tag;
+      // Whether the allocation was counted in the statistics.
+      uint32_t counted;
+      // From the start of the block to the allocation.
+      size_t offset;
+    };
+
+    const size_t header_size = (sizeof(allocation_header) + alignof(std::max_align_t) - 1)
+                               / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    const int number_of_size_classes = 64;
+
+    // Tag 0 is for allocations with no tag or call site, and the last
+    // tag for any tags beyond the limit.
+    const uint32_t max_tags = 1024;
+
+    struct size_class_counters
+    {
+      std::atomic<size_t> allocations;
+      std::atomic<size_t> frees;
+      std::atomic<size_t> bytes;
+    };
+
+    struct tag_counters
+    {
+      std::atomic<size_t> allocations;
+      std::atomic<size_t> frees;
+      std::atomic<int64_t> current;
+      std::atomic<int64_t> peak;
+      std::atomic<size_t> bytes;
+    };
+
+    std::atomic<bool> statistics_enabled (false);
+    size_class_counters size_classes[number_of_size_classes];
+    tag_counters tags[max_tags];
+
+    std::mutex tag_mutex;
+    std::vector<std::string> tag_names (1, "(untagged)");
+    std::map<std::string, uint32_t> tag_ids;
+    std::map<const void*, uint32_t> call_site_ids;
+
+    // The tag set by scoped_tag, or 0.
+    thread_local uint32_t this_thread_tag;
+
+    // The ids of call sites recently used by this thread, so that
+    // tag_mutex is only locked for a new call site.  Ids never change
+    // once assigned.
+    struct call_site_entry
+    {
+      const void* site;
+      uint32_t id;
+    };
+
+    const size_t call_site_cache_size = 64;
+
+    thread_local call_site_entry call_site_cache[call_site_cache_size];
+
+    // Returns the id for a name, adding it if necessary.  tag_mutex must
+    // be locked.
+    uint32_t add_tag (const std::string& name)
+    {
+      if (tag_names.size() == max_tags - 1)
+      { tag_names.push_back ("(other)"); }
+      if (tag_names.size() == max_tags)
+      { return max_tags - 1; }
+      tag_names.push_back (name);
+      return uint32_t(tag_names.size() - 1);
+    }
+
+    uint32_t tag_id (const char* tag)
+    {
+      std::lock_guard<std::mutex> lock (tag_mutex);
+      std::map<std::string, uint32_t>::const_iterator i = tag_ids.find (tag);
+      if (i != tag_ids.end())
+      { return i->second; }
+      const uint32_t id = add_tag (tag);
+      tag_ids[tag] = id;
+      return id;
+    }
+
+    uint32_t call_site_id (const void* site)
+    {
+      if (site == NULL)
+      { return 0; }
+      call_site_entry& entry = call_site_cache[(size_t(site) >> 2) % call_site_cache_size];
+      if (entry.site == site)
+      { return entry.id; }
+      std::lock_guard<std::mutex> lock (tag_mutex);
+      std::map<const void*, uint32_t>::const_iterator i = call_site_ids.find (site);
+      if (i != call_site_ids.end())
+      {
+        entry.site = site;
+        entry.id = i->second;
+        return i->second;
+      }
+      // Where possible, give the module and offset, which don't change
+      // from run to run and can be resolved with addr2line.
+      char name[256];
+      snprintf (name, sizeof(name), "%p", site);
+#ifdef N88_HAVE_DLADDR
+      Dl_info info;
+      if (dladdr (site, &info) && info.dli_fname && info.dli_fbase)
+      {
+        const char* module = strrchr (info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        snprintf (name, sizeof(name), "%s+0x%zx", module,
+                  size_t((const char*)site - (const char*)info.dli_fbase));
+      }
+#endif
+      const uint32_t id = add_tag (name);
+      call_site_ids[site] = id;
+      entry.site = site;
+      entry.id = id;
+      return id;
+    }
+
+    // Size class k holds sizes in [2^k, 2^(k+1)), except that class 0
+    // also holds 0.
+    int size_class (size_t size)
+    {
+      int k = 0;
+      while (size >>= 1)
+      { ++k; }
+      return k;
+    }
+
+    void count_allocation (uint32_t tag, size_t size)
+    {
+      size_class_counters& c = size_classes[size_class (size)];
+      c.allocations.fetch_add (1, std::memory_order_relaxed);
+      c.bytes.fetch_add (size, std::memory_order_relaxed);
+      tag_counters& t = tags[tag];
+      t.allocations.fetch_add (1, std::memory_order_relaxed);
+      t.bytes.fetch_add (size, std::memory_order_relaxed);
+      const int64_t current = t.current.fetch_add (size, std::memory_order_relaxed) + size;
+      int64_t peak = t.peak.load (std::memory_order_relaxed);
+      while (current > peak
+             && !t.peak.compare_exchange_weak (peak, current, std::memory_order_relaxed))
+      {}
+    }
+
+    void count_free (uint32_t tag, size_t size)
     {
-      if (allocated.get() == NULL)
+      size_classes[size_class (size)].frees.fetch_add (1, std::memory_order_relaxed);
+      tag_counters& t = tags[tag];
+      t.frees.fetch_add (1, std::memory_order_relaxed);
+      t.current.fetch_sub (size, std::memory_order_relaxed);
+    }
+
+    // alignment must be a power of 2.
+    void* allocate_with_header (size_t size, size_t alignment, const char* tag, const void* site)
+    {
+      // Room to move the allocation up to an aligned address.
+      const size_t padding = alignment > alignof(std::max_align_t) ? alignment : 0;
+      if (size > SIZE_MAX - header_size - padding)
+      { return NULL; }
+      char* block = (char*)malloc (header_size + padding + size);
+      if (block == NULL)
+      { return NULL; }
+      size_t offset = header_size;
+      if (padding)
+      { offset = (size_t(block) + header_size + alignment - 1) / alignment * alignment - size_t(block); }
+      allocation_header* header = (allocation_header*)(block + offset - header_size);
+      header->offset = offset;
+      header->tag = 0;
+      header->counted = 0;
+      if (statistics_enabled.load (std::memory_order_relaxed))
       {
-        allocated.reset(new TrackingAllocatorValues);
-        allocated->current = 0;
-        allocated->peak = 0;
+        if (tag)
+        { header->tag = tag_id (tag); }
+        else if (this_thread_tag)
+        { header->tag = this_thread_tag; }
+        else
+        { header->tag = call_site_id (site); }
+        header->counted = 1;
+        count_allocation (header->tag, size);
       }
-      allocated->current += size;
-      if (allocated->current > allocated->peak)
+      return block + offset;
+    }
+
+    thread_values& values()
+    {
+      thread_values& v = this_thread_values;
+      if (!v.registered)
       {
-        allocated->peak = allocated->current;
+        v.registered = true;
+        // The first use of this_thread_exit arranges for its destruction.
+        (void)&this_thread_exit;
       }
+      return v;
     }
-    return p;
+
+    std::atomic<bool> limits_set (false);
+    std::atomic<size_t> soft_limit (0);
+    std::atomic<size_t> hard_limit (0);
+    std::mutex limit_mutex;
+    TrackingAllocator::memory_limit_callback limit_callback;
+
+    // Set while this thread is in the limit callback.
+    thread_local bool in_limit_callback;
+
+    bool call_limit_callback (TrackingAllocator::memory_limit_t limit, size_t requested, int64_t current)
+    {
+      TrackingAllocator::memory_limit_callback callback;
+      if (!in_limit_callback)
+      {
+        std::lock_guard<std::mutex> lock (limit_mutex);
+        callback = limit_callback;
+      }
+      if (!callback)
+      { return limit == TrackingAllocator::SOFT_LIMIT; }
+      in_limit_callback = true;
+      bool result = false;
+      try
+      { result = callback (limit, requested, current < 0 ? 0 : size_t(current)); }
+      catch (...)
+      {
+        in_limit_callback = false;
+        throw;
+      }
+      in_limit_callback = false;
+      return result;
+    }
+
+    // Adds size to the global total if that is within the limits.
+    bool reserve (size_t size)
+    {
+      if (size > size_t(INT64_MAX))
+      { return false; }
+      bool soft_accepted = false;
+      bool hard_retried = false;
+      int64_t current = global_current.load (std::memory_order_relaxed);
+      for (;;)
+      {
+        const int64_t after = current + int64_t(size);
+        const size_t hard = hard_limit.load (std::memory_order_relaxed);
+        const size_t soft = soft_limit.load (std::memory_order_relaxed);
+        if (hard && after > int64_t(hard))
+        {
+          if (hard_retried || !call_limit_callback (TrackingAllocator::HARD_LIMIT, size, current))
+          { return false; }
+          hard_retried = true;
+          current = global_current.load (std::memory_order_relaxed);
+          continue;
+        }
+        if (soft && after > int64_t(soft) && !soft_accepted)
+        {
+          if (!call_limit_callback (TrackingAllocator::SOFT_LIMIT, size, current))
+          { return false; }
+          soft_accepted = true;
+          current = global_current.load (std::memory_order_relaxed);
+          continue;
+        }
+        if (global_current.compare_exchange_weak (current, after, std::memory_order_relaxed))
+        {
+          int64_t peak = global_peak.load (std::memory_order_relaxed);
+          while (after > peak
+                 && !global_peak.compare_exchange_weak (peak, after, std::memory_order_relaxed))
+          {}
+          return true;
+        }
+      }
+    }
+
+    // reserved is true if the size has already been added to the global
+    // total.
+    void increase (size_t size, size_t count, bool reserved)
+    {
+      thread_values& v = values();
+      v.current += size;
+      if (v.current > v.peak)
+      {
+        v.peak = v.current;
+      }
+      if (!reserved)
+      {
+        v.pending += size;
+      }
+      v.pending_count += count;
+      if (v.pending >= TrackingAllocator::merge_threshold || v.exiting
+          || limits_set.load (std::memory_order_relaxed))
+      {
+        merge (v);
+      }
+    }
+
+    void decrease (size_t size)
+    {
+      thread_values& v = values();
+      v.current -= size;
+      v.pending -= size;
+      if (v.pending <= -TrackingAllocator::merge_threshold || v.exiting
+          || limits_set.load (std::memory_order_relaxed))
+      {
+        merge (v);
+      }
+    }
+
+    void* allocate_tracked (size_t size, size_t alignment, const char* tag, const void* site)
+    {
+      bool reserved = false;
+      if (limits_set.load (std::memory_order_relaxed))
+      {
+        // So that the global total is exact for this thread.
+        merge (values());
+        if (!reserve (size))
+        { return NULL; }
+        reserved = true;
+      }
+      void* p = allocate_with_header (size, alignment, tag, site);
+      if (p)
+      {
+        increase (size, 1, reserved);
+      }
+      else if (reserved)
+      {
+        global_current.fetch_sub (size, std::memory_order_relaxed);
+      }
+      return p;
+    }
+
+  }  // anonymous namespace
+
+  void* TrackingAllocator::allocate(size_t size)
+  {
+    return allocate_tracked (size, 0, NULL, N88_CALL_SITE());
+  }
+
+  void* TrackingAllocator::allocate(size_t size, const char* tag)
+  {
+    return allocate_tracked (size, 0, tag, N88_CALL_SITE());
+  }
+
+  void* TrackingAllocator::allocate_aligned (size_t size, size_t alignment)
+  {
+    n88_assert (alignment != 0 && (alignment & (alignment - 1)) == 0);
+    return allocate_tracked (size, alignment, NULL, N88_CALL_SITE());
+  }
+
+  void* TrackingAllocator::allocate_aligned (size_t size, size_t alignment, const void* site)
+  {
+    n88_assert (alignment != 0 && (alignment & (alignment - 1)) == 0);
+    return allocate_tracked (size, alignment, NULL, site);
   }
 
   void TrackingAllocator::release (void* p, size_t size)
   {
-    n88_assert (allocated.get());
-    free (p);
-    allocated->current -= size;
+    if (p == NULL)
+      { return; }
+    allocation_header* header = (allocation_header*)((char*)p - header_size);
+    if (header->counted)
+    {
+      count_free (header->tag, size);
+    }
+    free ((char*)p - header->offset);
+    decrease (size);
   }
 
   void TrackingAllocator::external_increase (size_t size)
   {
-    allocated->current += size;
-    if (allocated->current > allocated->peak)
-    {
-      allocated->peak = allocated->current;
-    }    
+    increase (size, 0, false);
   }
 
   void TrackingAllocator::external_decrease (size_t size)
   {
-    allocated->current -= size;
+    decrease (size);
   }
 
   size_t TrackingAllocator::get_current_allocated()
   {
-    if (allocated.get() == NULL)
+    if (this_thread_values.current < 0)
       { return 0; }
-    return allocated->current;
+    return this_thread_values.current;
   }
 
   size_t TrackingAllocator::get_peak_allocated()
   {
-    if (allocated.get() == NULL)
-      { return 0; }
-    return allocated->peak;
+    return this_thread_values.peak;
+  }
+
+  void TrackingAllocator::merge_allocated()
+  {
+    merge (this_thread_values);
+  }
+
+  size_t TrackingAllocator::get_global_current_allocated()
+  {
+    merge_allocated();
+    const int64_t current = global_current.load (std::memory_order_relaxed);
+    return current < 0 ? 0 : current;
+  }
+
+  size_t TrackingAllocator::get_global_peak_allocated()
+  {
+    merge_allocated();
+    return global_peak.load (std::memory_order_relaxed);
+  }
+
+  size_t TrackingAllocator::get_global_allocation_count()
+  {
+    merge_allocated();
+    return global_count.load (std::memory_order_relaxed);
+  }
+
+  void TrackingAllocator::set_statistics_enabled (bool enabled)
+  {
+    statistics_enabled.store (enabled, std::memory_order_relaxed);
+  }
+
+  bool TrackingAllocator::get_statistics_enabled ()
+  {
+    return statistics_enabled.load (std::memory_order_relaxed);
+  }
+
+  std::vector<TrackingAllocatorSizeClass> TrackingAllocator::get_size_histogram ()
+  {
+    std::vector<TrackingAllocatorSizeClass> histogram;
+    for (int k=0; k<number_of_size_classes; ++k)
+    {
+      TrackingAllocatorSizeClass c;
+      c.allocations = size_classes[k].allocations.load (std::memory_order_relaxed);
+      if (c.allocations == 0)
+        { continue; }
+      c.min_size = (k == 0) ? 0 : size_t(1) << k;
+      c.max_size = (k == number_of_size_classes - 1) ? SIZE_MAX : (size_t(1) << (k+1)) - 1;
+      c.frees = size_classes[k].frees.load (std::memory_order_relaxed);
+      c.bytes = size_classes[k].bytes.load (std::memory_order_relaxed);
+      histogram.push_back (c);
+    }
+    return histogram;
+  }
+
+  std::vector<TrackingAllocatorTagStatistics> TrackingAllocator::get_tag_statistics ()
+  {
+    std::vector<std::string> names;
+    {
+      std::lock_guard<std::mutex> lock (tag_mutex);
+      names = tag_names;
+    }
+    std::vector<TrackingAllocatorTagStatistics> statistics;
+    for (size_t i=0; i<names.size(); ++i)
+    {
+      TrackingAllocatorTagStatistics t;
+      t.allocations = tags[i].allocations.load (std::memory_order_relaxed);
+      if (t.allocations == 0)
+        { continue; }
+      t.tag = names[i];
+      t.frees = tags[i].frees.load (std::memory_order_relaxed);
+      const int64_t current = tags[i].current.load (std::memory_order_relaxed);
+      t.current = current < 0 ? 0 : current;
+      t.peak = tags[i].peak.load (std::memory_order_relaxed);
+      t.bytes = tags[i].bytes.load (std::memory_order_relaxed);
+      statistics.push_back (t);
+    }
+    return statistics;
+  }
+
+  void TrackingAllocator::report_statistics (std::ostream& out)
+  {
+    char line[256];
+    snprintf (line, sizeof(line), "%-24s %12s %12s %16s\n",
+              "Size (bytes)", "Allocations", "Frees", "Bytes");
+    out << line;
+    const std::vector<TrackingAllocatorSizeClass> histogram = get_size_histogram();
+    for (size_t i=0; i<histogram.size(); ++i)
+    {
+      const TrackingAllocatorSizeClass& c = histogram[i];
+      char range[64];
+      snprintf (range, sizeof(range), "%zu-%zu", c.min_size, c.max_size);
+      snprintf (line, sizeof(line), "%-24s %12zu %12zu %16zu\n",
+                range, c.allocations, c.frees, c.bytes);
+      out << line;
+    }
+    out << "\n";
+    snprintf (line, sizeof(line), "%-24s %12s %12s %16s %16s %16s\n",
+              "Tag", "Allocations", "Frees", "Current", "Peak", "Bytes");
+    out << line;
+    const std::vector<TrackingAllocatorTagStatistics> statistics = get_tag_statistics();
+    for (size_t i=0; i<statistics.size(); ++i)
+    {
+      const TrackingAllocatorTagStatistics& t = statistics[i];
+      out << t.tag;
+      snprintf (line, sizeof(line), " %12zu %12zu %16zu %16zu %16zu\n",
+                t.allocations, t.frees, t.current, t.peak, t.bytes);
+      if (t.tag.size() < 24)
+        { out << std::string (24 - t.tag.size(), ' '); }
+      out << line;
+    }
+  }
+
+  void TrackingAllocator::set_memory_limits (size_t soft, size_t hard)
+  {
+    soft_limit.store (soft, std::memory_order_relaxed);
+    hard_limit.store (hard, std::memory_order_relaxed);
+    limits_set.store (soft != 0 || hard != 0, std::memory_order_relaxed);
+  }
+
+  size_t TrackingAllocator::get_memory_limit (memory_limit_t limit)
+  {
+    return (limit == SOFT_LIMIT ? soft_limit : hard_limit).load (std::memory_order_relaxed);
+  }
+
+  void TrackingAllocator::set_memory_limit_callback (memory_limit_callback callback)
+  {
+    std::lock_guard<std::mutex> lock (limit_mutex);
+    limit_callback = callback;
+  }
+
+  size_t TrackingAllocator::get_memory_headroom (memory_limit_t limit)
+  {
+    const size_t l = get_memory_limit (limit);
+    if (l == 0)
+      { return SIZE_MAX; }
+    const size_t current = get_global_current_allocated();
+    return current >= l ? 0 : l - current;
+  }
+
+  TrackingAllocator::scoped_tag::scoped_tag (const char* tag)
+    :
+    m_previous (this_thread_tag)
+  {
+    if (statistics_enabled.load (std::memory_order_relaxed))
+    {
+      this_thread_tag = tag_id (tag);
+    }
+  }
+
+  TrackingAllocator::scoped_tag::~scoped_tag ()
+  {
+    this_thread_tag = this->m_previous;
   }
 
 } // namespace n88
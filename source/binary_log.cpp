@@ -0,0 +1,292 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#include "n88util/binary_log.hpp"
+#include "n88util/exception.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define N88UTIL_HAVE_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define N88UTIL_HAVE_RDTSC
+#endif
+
+namespace n88
+{
+
+  namespace io
+  {
+
+    namespace
+    {
+
+      struct format_entry
+      {
+        const char* format;
+        std::string tags;
+      };
+
+      // Formats indexed by id - 1.
+      std::mutex registry_mutex;
+      std::vector<format_entry> registry;
+
+      // Reads binary log data from a stream, checking that it does not run
+      // past the end.
+      class record_reader
+      {
+        public:
+
+          explicit record_reader (std::istream& in)
+            :
+            m_in (in)
+          {}
+
+          bool at_end ()
+          { return this->m_in.peek() == std::char_traits<char>::eof(); }
+
+          template <typename T>
+          T read ()
+          {
+            T x;
+            this->read_bytes (&x, sizeof(x));
+            return x;
+          }
+
+          std::string read_string ()
+          {
+            const uint32_t n = this->read<uint32_t>();
+            std::string s;
+            // Grow as the data arrives, so that a corrupt length cannot
+            // cause a huge allocation.
+            const size_t block = 4096;
+            while (s.size() < n)
+            {
+              const size_t offset = s.size();
+              const size_t count = std::min (size_t(n) - offset, block);
+              s.resize (offset + count);
+              this->read_bytes (&s[offset], count);
+            }
+            return s;
+          }
+
+          void read_bytes (void* p, size_t n)
+          {
+            this->m_in.read ((char*)p, n);
+            if ((size_t)this->m_in.gcount() != n)
+            { throw_n88_exception ("Truncated binary log."); }
+          }
+
+        protected:
+
+          std::istream& m_in;
+      };
+
+      // An event that has been formatted but whose time cannot be
+      // calculated until the following clock record is read.
+      struct pending_event
+      {
+        uint64_t timestamp;
+        uint8_t level;
+        std::string text;
+      };
+
+      // Names of the levels, indexed by LogLevel_t.
+      const char* const level_names[] = { "VERBOSE", "INFORMATIVE", "IMPORTANT", "ERROR" };
+
+      void write_event (const pending_event& event, double seconds, std::ostream& out)
+      {
+        char prefix[48];
+        if (event.level < sizeof(level_names)/sizeof(level_names[0]))
+        { snprintf (prefix, sizeof(prefix), "%12.6f %-11s ", seconds, level_names[event.level]); }
+        else
+        { snprintf (prefix, sizeof(prefix), "%12.6f %-11u ", seconds, (unsigned)event.level); }
+        out << prefix << event.text;
+        if (event.text.empty() || event.text[event.text.size()-1] != '\n')
+        { out << '\n'; }
+      }
+
+      // Reads one argument and writes it as text.
+      void decode_argument (record_reader& reader, char tag, std::ostream& out)
+      {
+        switch (tag)
+        {
+          case '?': out << (reader.read<uint8_t>() ? "true" : "false"); break;
+          case 'c': out << reader.read<char>(); break;
+          case 'i': out << reader.read<int32_t>(); break;
+          case 'I': out << reader.read<uint32_t>(); break;
+          case 'q': out << reader.read<int64_t>(); break;
+          case 'Q': out << reader.read<uint64_t>(); break;
+          case 'f': out << reader.read<float>(); break;
+          case 'd': out << reader.read<double>(); break;
+          case 's': out << reader.read_string(); break;
+          default:
+            throw_n88_exception (std::string ("Unknown argument type in binary log: ") + tag);
+        }
+      }
+
+      const char magic[] = "N88BLOG1";
+
+    }  // anonymous namespace
+
+    //-----------------------------------------------------------------------
+    uint64_t binary_log_timestamp ()
+    {
+#ifdef N88UTIL_HAVE_RDTSC
+      return __rdtsc();
+#else
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds> (
+                 std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    //-----------------------------------------------------------------------
+    uint32_t binary_log_format::Register (const char* tags) const
+    {
+      std::lock_guard<std::mutex> lock (registry_mutex);
+      // Another thread may have got here first.
+      uint32_t id = this->m_id.load (std::memory_order_relaxed);
+      if (id == 0)
+      {
+        format_entry entry;
+        entry.format = this->m_format;
+        entry.tags = tags;
+        registry.push_back (entry);
+        id = (uint32_t)registry.size();
+        this->m_id.store (id, std::memory_order_release);
+      }
+      return id;
+    }
+
+    bool binary_log_format::Lookup (uint32_t id, std::string& format, std::string& tags)
+    {
+      std::lock_guard<std::mutex> lock (registry_mutex);
+      if (id == 0 || id > registry.size())
+      { return false; }
+      format = registry[id-1].format;
+      tags = registry[id-1].tags;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------
+    size_t decode_binary_log (std::istream& in, std::ostream& out)
+    {
+      record_reader reader (in);
+      char header[sizeof(magic) - 1 + sizeof(uint32_t)];
+      in.read (header, sizeof(header));
+      if ((size_t)in.gcount() != sizeof(header) || memcmp (header, magic, sizeof(magic) - 1) != 0)
+      { throw_n88_exception ("Not a binary log."); }
+      uint32_t byte_order;
+      memcpy (&byte_order, header + sizeof(magic) - 1, sizeof(byte_order));
+      if (byte_order != 0x01020304)
+      { throw_n88_exception ("Binary log was written with a different byte order."); }
+
+      // Time stamps are converted using the clock records on either side,
+      // so events are held until the next clock record is read.  Only
+      // the events since the last clock record are buffered.
+      std::map<uint32_t, std::pair<std::string, std::string> > formats;
+      std::vector<pending_event> pending;
+      bool have_clock = false;
+      int64_t first_ns = 0;
+      uint64_t last_timestamp = 0;
+      int64_t last_ns = 0;
+      double tick = 0;     // Nanoseconds per time stamp tick; 0 if unknown.
+      size_t count = 0;
+      std::ostringstream message;
+      while (!reader.at_end())
+      {
+        const uint8_t type = reader.read<uint8_t>();
+        if (type == BINARY_LOG_DEFINE)
+        {
+          const uint32_t id = reader.read<uint32_t>();
+          std::string format = reader.read_string();
+          formats[id] = std::make_pair (format, reader.read_string());
+        }
+        else if (type == BINARY_LOG_EVENT)
+        {
+          const auto f = formats.find (reader.read<uint32_t>());
+          if (f == formats.end())
+          { throw_n88_exception ("Binary log event with undefined format."); }
+          const std::pair<std::string, std::string>& format = f->second;
+          pending_event event;
+          event.timestamp = reader.read<uint64_t>();
+          event.level = reader.read<uint8_t>();
+          message.str ("");
+          size_t arg = 0;
+          for (size_t i=0; i<format.first.size(); ++i)
+          {
+            if (format.first.compare (i, 2, "{}") == 0 && arg < format.second.size())
+            {
+              decode_argument (reader, format.second[arg++], message);
+              ++i;
+            }
+            else
+            { message << format.first[i]; }
+          }
+          // Arguments without a placeholder.
+          for (; arg < format.second.size(); ++arg)
+          {
+            message << ' ';
+            decode_argument (reader, format.second[arg], message);
+          }
+          event.text = message.str();
+          pending.push_back (std::move (event));
+        }
+        else if (type == BINARY_LOG_CLOCK)
+        {
+          const uint64_t timestamp = reader.read<uint64_t>();
+          const int64_t ns = reader.read<int64_t>();
+          if (!have_clock)
+          {
+            have_clock = true;
+            first_ns = ns;
+          }
+          else
+          {
+            if (timestamp > last_timestamp)
+            { tick = double (ns - last_ns) / double (timestamp - last_timestamp); }
+            if (tick > 0)
+            {
+              // Events may precede the first clock record slightly.
+              for (const pending_event& event : pending)
+              {
+                const double seconds = (double (last_ns - first_ns)
+                    + double (int64_t (event.timestamp - last_timestamp)) * tick) * 1E-9;
+                write_event (event, seconds, out);
+              }
+              count += pending.size();
+              pending.clear();
+            }
+          }
+          last_timestamp = timestamp;
+          last_ns = ns;
+        }
+        else
+        { throw_n88_exception ("Unknown record in binary log."); }
+      }
+      if (!have_clock)
+      { throw_n88_exception ("Binary log has no clock records."); }
+      // Events after the last clock record use the latest tick.  If there
+      // was only one clock record the tick is unknown, so the events are
+      // shown at the time of that record.
+      for (const pending_event& event : pending)
+      {
+        double seconds = double (last_ns - first_ns) * 1E-9;
+        if (tick > 0)
+        { seconds += double (int64_t (event.timestamp - last_timestamp)) * tick * 1E-9; }
+        write_event (event, seconds, out);
+      }
+      count += pending.size();
+      return count;
+    }
+
+  }  // namespace io
+
+}  // namespace n88
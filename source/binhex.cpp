@@ -3,14 +3,261 @@
 
 #include "n88util/binhex.hpp"
 #include <cstring>
-#include <cstdio>
 #include <cstdlib>
+#include <istream>
+#include <ostream>
+
+// SIMD kernels are compiled with per-function target attributes, so no
+// special compiler flags are required, and are selected at run time
+// according to the capabilities of the CPU.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define N88UTIL_BINHEX_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace n88util
 {
-  
-  const char valid_hex_chars[] = "0123456789ABCDEF";
-  
+
+  namespace
+  {
+
+    const char valid_hex_chars[] = "0123456789ABCDEF";
+
+    // Size in bytes of the binary chunks used by the stream functions.
+    const size_t stream_chunk_size = 1 << 16;
+
+    const char lower_case_hex_chars[] = "0123456789abcdef";
+
+    // Maps a character to its value as a hexadecimal digit, or -1 if it is
+    // not a valid hexadecimal digit.
+    struct hex_decode_table
+    {
+      signed char value[256];
+
+      explicit hex_decode_table(bool any_case)
+      {
+        memset (value, -1, sizeof(value));
+        for (int i=0; i<16; ++i)
+        {
+          value[(unsigned char)valid_hex_chars[i]] = (signed char)i;
+          if (any_case)
+          { value[(unsigned char)lower_case_hex_chars[i]] = (signed char)i; }
+        }
+      }
+    };
+
+    const hex_decode_table upper_case_decode_table (false);
+    const hex_decode_table any_case_decode_table (true);
+
+    //---------------------------------------------------------------------
+    void encode_scalar (const unsigned char* buf, size_t len, char* hex)
+    {
+      for (size_t i=0; i<len; ++i)
+      {
+        hex[2*i]   = valid_hex_chars[buf[i] >> 4];
+        hex[2*i+1] = valid_hex_chars[buf[i] & 0x0F];
+      }
+    }
+
+    //---------------------------------------------------------------------
+    // Decodes npairs pairs of hexadecimal characters.  Returns the index of
+    // the first invalid character, or 2*npairs if all are valid.
+    template <bool any_case>
+    size_t decode_scalar (const char* hex, size_t npairs, unsigned char* buf)
+    {
+      const hex_decode_table& decode_table =
+          any_case ? any_case_decode_table : upper_case_decode_table;
+      for (size_t i=0; i<npairs; ++i)
+      {
+        const int hi = decode_table.value[(unsigned char)hex[2*i]];
+        const int lo = decode_table.value[(unsigned char)hex[2*i+1]];
+        if ((hi | lo) < 0)
+        { return hi < 0 ? 2*i : 2*i+1; }
+        buf[i] = (unsigned char)((hi << 4) | lo);
+      }
+      return 2*npairs;
+    }
+
+#ifdef N88UTIL_BINHEX_X86_SIMD
+
+    //---------------------------------------------------------------------
+    // Index of the lowest zero bit of a mask of valid characters.
+    inline size_t first_invalid (unsigned long long valid)
+    { return (size_t)__builtin_ctzll (~valid); }
+
+    //---------------------------------------------------------------------
+    __attribute__((target("ssse3")))
+    void encode_ssse3 (const unsigned char* buf, size_t len, char* hex)
+    {
+      const __m128i digits = _mm_loadu_si128 ((const __m128i*)valid_hex_chars);
+      const __m128i nibble = _mm_set1_epi8 (0x0F);
+      size_t i = 0;
+      for (; i+16 <= len; i += 16)
+      {
+        const __m128i v = _mm_loadu_si128 ((const __m128i*)(buf+i));
+        const __m128i hi = _mm_shuffle_epi8 (digits, _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble));
+        const __m128i lo = _mm_shuffle_epi8 (digits, _mm_and_si128 (v, nibble));
+        _mm_storeu_si128 ((__m128i*)(hex+2*i), _mm_unpacklo_epi8 (hi, lo));
+        _mm_storeu_si128 ((__m128i*)(hex+2*i+16), _mm_unpackhi_epi8 (hi, lo));
+      }
+      encode_scalar (buf+i, len-i, hex+2*i);
+    }
+
+    //---------------------------------------------------------------------
+    // Converts 16 characters to their values; returns a bit mask of the
+    // characters that are valid.
+    template <bool any_case>
+    __attribute__((target("ssse3")))
+    inline unsigned int classify_ssse3 (__m128i c, __m128i& value)
+    {
+      const __m128i d = _mm_sub_epi8 (c, _mm_set1_epi8 ('0'));
+      const __m128i is_digit = _mm_cmpeq_epi8 (_mm_min_epu8 (d, _mm_set1_epi8 (9)), d);
+      // Setting bit 5 maps upper case letters to lower case, and does not
+      // map any other character to a letter.
+      const __m128i l = any_case ? _mm_sub_epi8 (_mm_or_si128 (c, _mm_set1_epi8 (0x20)), _mm_set1_epi8 ('a'))
+                                 : _mm_sub_epi8 (c, _mm_set1_epi8 ('A'));
+      const __m128i is_letter = _mm_cmpeq_epi8 (_mm_min_epu8 (l, _mm_set1_epi8 (5)), l);
+      value = _mm_or_si128 (_mm_and_si128 (is_digit, d),
+                            _mm_and_si128 (is_letter, _mm_add_epi8 (l, _mm_set1_epi8 (10))));
+      return (unsigned int)_mm_movemask_epi8 (_mm_or_si128 (is_digit, is_letter));
+    }
+
+    //---------------------------------------------------------------------
+    template <bool any_case>
+    __attribute__((target("ssse3")))
+    size_t decode_ssse3 (const char* hex, size_t npairs, unsigned char* buf)
+    {
+      // Multiplying pairs of nibbles by (16,1) and adding combines them.
+      const __m128i weights = _mm_set1_epi16 (0x0110);
+      size_t i = 0;
+      for (; i+16 <= npairs; i += 16)
+      {
+        __m128i va, vb;
+        const unsigned int ma = classify_ssse3<any_case> (_mm_loadu_si128 ((const __m128i*)(hex+2*i)), va);
+        const unsigned int mb = classify_ssse3<any_case> (_mm_loadu_si128 ((const __m128i*)(hex+2*i+16)), vb);
+        const unsigned int valid = ma | (mb << 16);
+        if (valid != 0xFFFFFFFFu)
+        { return 2*i + first_invalid (valid | 0xFFFFFFFF00000000ull); }
+        const __m128i wa = _mm_maddubs_epi16 (va, weights);
+        const __m128i wb = _mm_maddubs_epi16 (vb, weights);
+        _mm_storeu_si128 ((__m128i*)(buf+i), _mm_packus_epi16 (wa, wb));
+      }
+      return 2*i + decode_scalar<any_case> (hex+2*i, npairs-i, buf+i);
+    }
+
+    //---------------------------------------------------------------------
+    __attribute__((target("avx2")))
+    void encode_avx2 (const unsigned char* buf, size_t len, char* hex)
+    {
+      const __m256i digits = _mm256_broadcastsi128_si256 (
+                                 _mm_loadu_si128 ((const __m128i*)valid_hex_chars));
+      const __m256i nibble = _mm256_set1_epi8 (0x0F);
+      size_t i = 0;
+      for (; i+32 <= len; i += 32)
+      {
+        const __m256i v = _mm256_loadu_si256 ((const __m256i*)(buf+i));
+        const __m256i hi = _mm256_shuffle_epi8 (digits, _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble));
+        const __m256i lo = _mm256_shuffle_epi8 (digits, _mm256_and_si256 (v, nibble));
+        // unpack works within 128 bit lanes; permute the lanes back in order.
+        const __m256i a = _mm256_unpacklo_epi8 (hi, lo);
+        const __m256i b = _mm256_unpackhi_epi8 (hi, lo);
+        _mm256_storeu_si256 ((__m256i*)(hex+2*i), _mm256_permute2x128_si256 (a, b, 0x20));
+        _mm256_storeu_si256 ((__m256i*)(hex+2*i+32), _mm256_permute2x128_si256 (a, b, 0x31));
+      }
+      encode_ssse3 (buf+i, len-i, hex+2*i);
+    }
+
+    //---------------------------------------------------------------------
+    template <bool any_case>
+    __attribute__((target("avx2")))
+    inline unsigned int classify_avx2 (__m256i c, __m256i& value)
+    {
+      const __m256i d = _mm256_sub_epi8 (c, _mm256_set1_epi8 ('0'));
+      const __m256i is_digit = _mm256_cmpeq_epi8 (_mm256_min_epu8 (d, _mm256_set1_epi8 (9)), d);
+      // Setting bit 5 maps upper case letters to lower case, and does not
+      // map any other character to a letter.
+      const __m256i l = any_case ? _mm256_sub_epi8 (_mm256_or_si256 (c, _mm256_set1_epi8 (0x20)), _mm256_set1_epi8 ('a'))
+                                 : _mm256_sub_epi8 (c, _mm256_set1_epi8 ('A'));
+      const __m256i is_letter = _mm256_cmpeq_epi8 (_mm256_min_epu8 (l, _mm256_set1_epi8 (5)), l);
+      value = _mm256_or_si256 (_mm256_and_si256 (is_digit, d),
+                               _mm256_and_si256 (is_letter, _mm256_add_epi8 (l, _mm256_set1_epi8 (10))));
+      return (unsigned int)_mm256_movemask_epi8 (_mm256_or_si256 (is_digit, is_letter));
+    }
+
+    //---------------------------------------------------------------------
+    template <bool any_case>
+    __attribute__((target("avx2")))
+    size_t decode_avx2 (const char* hex, size_t npairs, unsigned char* buf)
+    {
+      const __m256i weights = _mm256_set1_epi16 (0x0110);
+      size_t i = 0;
+      for (; i+32 <= npairs; i += 32)
+      {
+        __m256i va, vb;
+        const unsigned int ma = classify_avx2<any_case> (_mm256_loadu_si256 ((const __m256i*)(hex+2*i)), va);
+        const unsigned int mb = classify_avx2<any_case> (_mm256_loadu_si256 ((const __m256i*)(hex+2*i+32)), vb);
+        const unsigned long long valid = ma | ((unsigned long long)mb << 32);
+        if (valid != ~0ull)
+        { return 2*i + first_invalid (valid); }
+        const __m256i wa = _mm256_maddubs_epi16 (va, weights);
+        const __m256i wb = _mm256_maddubs_epi16 (vb, weights);
+        // pack works within 128 bit lanes; restore the order of the 64 bit blocks.
+        const __m256i packed = _mm256_permute4x64_epi64 (_mm256_packus_epi16 (wa, wb), 0xD8);
+        _mm256_storeu_si256 ((__m256i*)(buf+i), packed);
+      }
+      return 2*i + decode_ssse3<any_case> (hex+2*i, npairs-i, buf+i);
+    }
+
+#endif  // N88UTIL_BINHEX_X86_SIMD
+
+    typedef void (*encode_function_t) (const unsigned char*, size_t, char*);
+    typedef size_t (*decode_function_t) (const char*, size_t, unsigned char*);
+
+    //---------------------------------------------------------------------
+    encode_function_t select_encoder ()
+    {
+#ifdef N88UTIL_BINHEX_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports ("avx2"))
+      { return encode_avx2; }
+      if (__builtin_cpu_supports ("ssse3"))
+      { return encode_ssse3; }
+#endif
+      return encode_scalar;
+    }
+
+    //---------------------------------------------------------------------
+    template <bool any_case>
+    decode_function_t select_decoder ()
+    {
+#ifdef N88UTIL_BINHEX_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports ("avx2"))
+      { return decode_avx2<any_case>; }
+      if (__builtin_cpu_supports ("ssse3"))
+      { return decode_ssse3<any_case>; }
+#endif
+      return decode_scalar<any_case>;
+    }
+
+    //---------------------------------------------------------------------
+    void encode (const unsigned char* buf, size_t len, char* hex)
+    {
+      static const encode_function_t f = select_encoder();
+      f (buf, len, hex);
+    }
+
+    //---------------------------------------------------------------------
+    size_t decode (const char* hex, size_t npairs, unsigned char* buf,
+                   hex_case_t letter_case = HEX_UPPER_CASE)
+    {
+      static const decode_function_t upper_case = select_decoder<false>();
+      static const decode_function_t any_case = select_decoder<true>();
+      return (letter_case == HEX_ANY_CASE ? any_case : upper_case) (hex, npairs, buf);
+    }
+
+  }  // anonymous namespace
+
   //-----------------------------------------------------------------------
   int bintohex(const unsigned char *buf, long len, char** hex)
   {
@@ -24,33 +271,20 @@ namespace n88util
     {
       return 0;
     }
-    char* h = *hex;
-    h[2*len] = '\0';
-    char c[3];
-    while (len--)
-    {
-  	  sprintf(c, "%02X", *buf++);
-      strncpy(h, c, 2);
-      h += 2;
-    }
+    encode(buf, len, *hex);
+    (*hex)[2*len] = '\0';
     return 1;
   }
-  
+
   //-----------------------------------------------------------------------
-  // This is not particularly efficient, because the output is written
-  // to a temporary internal buffer and then copied.
   int bintohex(const unsigned char *buf, long len, std::string& hex)
   {
     hex.clear();
-    char* tmp = NULL;
-    if (!bintohex(buf,len,&tmp))
+    if (len < 0)
     {
-      free(tmp);
       return 0;
     }
-    hex = tmp;
-    free(tmp);
-    return 1;
+    return bintohex_append(buf, len, hex);
   }
 
   //-----------------------------------------------------------------------
@@ -63,38 +297,185 @@ namespace n88util
       *len = 0;
       return 0;
     }
-    unsigned char* b = *buf;
-    long l = *len;
-    char c[3];
-    int x;
-    while (l--)
+    if (decode(hex, *len, *buf) != 2*size_t(*len))
+    {
+      free(*buf);
+      *buf = NULL;
+      *len = 0;
+      return 0;
+    }
+    return 1;
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin(const std::string& hex, unsigned char** buf, long *len)
+  {
+    return hextobin(hex.c_str(), buf, len);
+  }
+
+  //-----------------------------------------------------------------------
+  int bintohex(const unsigned char *buf, size_t len, char* hex, size_t hex_size)
+  {
+    if (hex_size < 2*len)
+    {
+      return 0;
+    }
+    encode(buf, len, hex);
+    return 1;
+  }
+
+  //-----------------------------------------------------------------------
+  int bintohex_append(const unsigned char *buf, size_t len, std::string& hex)
+  {
+    const size_t offset = hex.size();
+    hex.resize(offset + 2*len);
+    encode(buf, len, &hex[0] + offset);
+    return 1;
+  }
+
+  //-----------------------------------------------------------------------
+  int bintohex_append(const unsigned char *buf, size_t len, std::vector<char>& hex)
+  {
+    const size_t offset = hex.size();
+    hex.resize(offset + 2*len);
+    encode(buf, len, hex.data() + offset);
+    return 1;
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin(std::string_view hex, unsigned char* buf, size_t buf_size)
+  {
+    return hextobin(hex, buf, buf_size, HEX_UPPER_CASE);
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin(std::string_view hex, unsigned char* buf, size_t buf_size,
+               hex_case_t letter_case, size_t* invalid_position)
+  {
+    const size_t len = hex.size()/2;
+    if (buf_size < len)
     {
-      c[2] = c[1] = c[0] = '\0';
-      strncpy(c, hex, 2);
-      if (!strchr(valid_hex_chars, c[0]) || !strchr(valid_hex_chars, c[1]))
+      if (invalid_position)
       {
-        free(*buf);
-        *buf = NULL;
-        *len = 0;
-        return 0;
+        *invalid_position = std::string_view::npos;
       }
-      if (sscanf(c, "%X", &x) != 1)
+      return 0;
+    }
+    const size_t position = decode(hex.data(), len, buf, letter_case);
+    if (invalid_position)
+    {
+      *invalid_position = position;
+    }
+    return position == 2*len;
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin_append(std::string_view hex, std::vector<unsigned char>& buf)
+  {
+    return hextobin_append(hex, buf, HEX_UPPER_CASE);
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin_append(std::string_view hex, std::vector<unsigned char>& buf,
+                      hex_case_t letter_case, size_t* invalid_position)
+  {
+    const size_t offset = buf.size();
+    const size_t len = hex.size()/2;
+    buf.resize(offset + len);
+    const size_t position = decode(hex.data(), len, buf.data() + offset, letter_case);
+    if (invalid_position)
+    {
+      *invalid_position = position;
+    }
+    if (position != 2*len)
+    {
+      buf.resize(offset);
+      return 0;
+    }
+    return 1;
+  }
+
+  //-----------------------------------------------------------------------
+  hex_decoder::hex_decoder(hex_case_t letter_case)
+    :
+    m_letter_case (letter_case),
+    m_pending ('\0'),
+    m_has_pending (false)
+  {}
+
+  //-----------------------------------------------------------------------
+  int hex_decoder::update(const char* hex, size_t len, unsigned char* buf, size_t* written)
+  {
+    *written = 0;
+    if (len == 0)
+    {
+      return 1;
+    }
+    if (this->m_has_pending)
+    {
+      const char pair[2] = {this->m_pending, hex[0]};
+      if (decode(pair, 1, buf, this->m_letter_case) != 2)
       {
-        free(*buf);
-        *buf = NULL;
-        *len = 0;
         return 0;
       }
-      *b++ = x;
-      hex += 2;
+      this->m_has_pending = false;
+      ++hex;
+      --len;
+      ++buf;
+      *written = 1;
+    }
+    const size_t npairs = len/2;
+    if (decode(hex, npairs, buf, this->m_letter_case) != 2*npairs)
+    {
+      return 0;
+    }
+    *written += npairs;
+    if (len % 2)
+    {
+      this->m_pending = hex[len-1];
+      this->m_has_pending = true;
     }
     return 1;
   }
 
   //-----------------------------------------------------------------------
-  int hextobin(const std::string& hex, unsigned char** buf, long *len)
+  int bintohex(std::istream& in, std::ostream& out)
   {
-    return hextobin(hex.c_str(), buf, len);
+    std::vector<unsigned char> buf(stream_chunk_size);
+    std::vector<char> hex(2*stream_chunk_size);
+    while (in)
+    {
+      in.read((char*)buf.data(), buf.size());
+      const size_t n = in.gcount();
+      encode(buf.data(), n, hex.data());
+      if (!out.write(hex.data(), 2*n))
+      {
+        return 0;
+      }
+    }
+    return in.eof() ? 1 : 0;
+  }
+
+  //-----------------------------------------------------------------------
+  int hextobin(std::istream& in, std::ostream& out)
+  {
+    std::vector<char> hex(2*stream_chunk_size);
+    std::vector<unsigned char> buf(stream_chunk_size);
+    hex_decoder decoder;
+    while (in)
+    {
+      in.read(hex.data(), hex.size());
+      size_t n;
+      if (!decoder.update(hex.data(), in.gcount(), buf.data(), &n))
+      {
+        return 0;
+      }
+      if (!out.write((const char*)buf.data(), n))
+      {
+        return 0;
+      }
+    }
+    return in.eof() ? 1 : 0;
   }
 
 }   // namespace n88util
@@ -0,0 +1,775 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#include "n88util/logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace n88
+{
+
+  namespace io
+  {
+
+    namespace
+    {
+
+      // Capacity in bytes of the queue of each thread.  Must be a power of 2.
+      const size_t ring_capacity = size_t(1) << 16;
+
+      // The largest record written to a queue.  Longer messages are
+      // written directly.
+      const size_t max_record_size = ring_capacity / 4;
+
+      // How often the background thread checks for output.
+      const std::chrono::milliseconds write_interval (5);
+
+      // Each record in a queue is a header followed by the text.
+      struct record_header
+      {
+        uint32_t size;
+        uint32_t flags;
+      };
+
+      enum record_flags_t {
+        TO_LOG = 1,
+        TO_CONSOLE = 2,
+        TO_BINARY = 4
+      };
+
+      const char binary_log_magic[] = "N88BLOG1";
+
+      /** A lock-free byte queue with a single producer and a single
+        * consumer.
+        *
+        * The producer writes any number of pieces and then publishes them
+        * together, so the consumer never sees a partial record.
+        */
+      class log_ring
+      {
+        public:
+
+          log_ring ()
+            :
+            m_buffer (ring_capacity),
+            m_pending (0),
+            m_head (0),
+            m_tail (0),
+            m_closed (false)
+          {}
+
+          /** Producer: space available for writing. */
+          size_t free_space () const
+          { return ring_capacity - (this->m_pending - this->m_tail.load (std::memory_order_acquire)); }
+
+          /** Producer: copies n bytes in after any unpublished bytes. */
+          void write (const void* p, size_t n)
+          {
+            const size_t offset = this->m_pending & (ring_capacity - 1);
+            const size_t first = std::min (n, ring_capacity - offset);
+            memcpy (&this->m_buffer[offset], p, first);
+            memcpy (&this->m_buffer[0], (const char*)p + first, n - first);
+            this->m_pending += n;
+          }
+
+          /** Producer: makes everything written available to the consumer. */
+          void publish ()
+          { this->m_head.store (this->m_pending, std::memory_order_release); }
+
+          /** Consumer: returns the number of bytes used. */
+          size_t used () const
+          {
+            return this->m_head.load (std::memory_order_acquire)
+                   - this->m_tail.load (std::memory_order_relaxed);
+          }
+
+          /** Consumer: copies out n bytes from position offset after the
+            * start of the readable bytes.
+            */
+          void peek (size_t offset, void* p, size_t n) const
+          {
+            const size_t start = (this->m_tail.load (std::memory_order_relaxed) + offset) & (ring_capacity - 1);
+            const size_t first = std::min (n, ring_capacity - start);
+            memcpy (p, &this->m_buffer[start], first);
+            memcpy ((char*)p + first, &this->m_buffer[0], n - first);
+          }
+
+          /** Consumer: releases n bytes back to the producer. */
+          void consume (size_t n)
+          {
+            this->m_tail.store (this->m_tail.load (std::memory_order_relaxed) + n,
+                                std::memory_order_release);
+          }
+
+          /** Set when the writer is destroyed, so that the producer thread
+            * knows to discard the queue.
+            */
+          std::atomic<bool>& closed ()
+          { return this->m_closed; }
+
+        protected:
+
+          std::vector<char> m_buffer;
+          size_t m_pending;                  // Producer only.
+          alignas(64) std::atomic<size_t> m_head;
+          alignas(64) std::atomic<size_t> m_tail;
+          std::atomic<bool> m_closed;
+      };
+
+      // Ensures that each writer has a distinct id, even if a new one is
+      // allocated at the address of an old one.
+      std::atomic<uint64_t> next_writer_id (1);
+
+    }  // anonymous namespace
+
+    /** The background thread and per-thread queues of a logger in
+      * asynchronous mode.
+      */
+    class log_async_writer
+    {
+      public:
+
+        explicit log_async_writer (logger* owner)
+          :
+          m_owner (owner),
+          m_id (next_writer_id++),
+          m_flushRequested (0),
+          m_flushCompleted (0),
+          m_stop (false)
+        {
+          this->m_thread = std::thread (&log_async_writer::Run, this);
+        }
+
+        ~log_async_writer ()
+        {
+          {
+            std::lock_guard<std::mutex> lock (this->m_mutex);
+            this->m_stop = true;
+          }
+          this->m_wake.notify_one();
+          this->m_thread.join();
+          for (std::shared_ptr<log_ring>& ring : this->m_rings)
+          { ring->closed() = true; }
+        }
+
+        /** Queues a message from the calling thread.  flags is a
+          * combination of record_flags_t.
+          */
+        void Write (const char* s, size_t n, unsigned int flags)
+        {
+          log_ring& ring = this->RingForThread();
+          if (n > max_record_size)
+          {
+            // Too big for the queue.  Once everything before it from this
+            // thread is written, write it directly.
+            while (ring.free_space() < ring_capacity)
+            {
+              this->m_wake.notify_one();
+              std::this_thread::yield();
+            }
+            std::lock_guard<std::mutex> lock (this->m_owner->m_outputMutex);
+            this->m_owner->Output (s, n, flags);
+            return;
+          }
+          record_header header;
+          header.size = (uint32_t)n;
+          header.flags = flags;
+          size_t free_space = ring.free_space();
+          while (free_space < sizeof(header) + n)
+          {
+            this->m_wake.notify_one();
+            std::this_thread::yield();
+            free_space = ring.free_space();
+          }
+          ring.write (&header, sizeof(header));
+          ring.write (s, n);
+          ring.publish();
+          // Don't wait for the next interval if the queue is filling up.
+          // Notify only once, when it passes half full.
+          if (free_space >= ring_capacity / 2
+              && free_space - (sizeof(header) + n) < ring_capacity / 2)
+          { this->m_wake.notify_one(); }
+        }
+
+        void Flush ()
+        {
+          std::unique_lock<std::mutex> lock (this->m_mutex);
+          const uint64_t ticket = ++this->m_flushRequested;
+          this->m_wake.notify_one();
+          while (this->m_flushCompleted < ticket)
+          { this->m_flushed.wait (lock); }
+        }
+
+      protected:
+
+        log_ring& RingForThread ()
+        {
+          // The queues of this thread for each writer it has used.  The
+          // entries are shared with the writers, so either may go first.
+          thread_local std::vector<std::pair<uint64_t, std::shared_ptr<log_ring> > > rings;
+          for (std::pair<uint64_t, std::shared_ptr<log_ring> >& entry : rings)
+          {
+            if (entry.first == this->m_id)
+            { return *entry.second; }
+          }
+          // New to this thread; clean up entries for writers that are gone.
+          for (size_t i=rings.size(); i>0; --i)
+          {
+            if (rings[i-1].second->closed())
+            { rings.erase (rings.begin() + (i-1)); }
+          }
+          std::shared_ptr<log_ring> ring = std::make_shared<log_ring>();
+          {
+            std::lock_guard<std::mutex> lock (this->m_mutex);
+            this->m_rings.push_back (ring);
+          }
+          rings.push_back (std::make_pair (this->m_id, ring));
+          return *ring;
+        }
+
+        void Run ()
+        {
+          std::vector<std::shared_ptr<log_ring> > rings;
+          std::unique_lock<std::mutex> lock (this->m_mutex);
+          while (true)
+          {
+            const uint64_t requested = this->m_flushRequested;
+            const bool stop = this->m_stop;
+            // Queues whose thread has exited are dropped once they are empty.
+            for (size_t i=this->m_rings.size(); i>0; --i)
+            {
+              if (this->m_rings[i-1].use_count() == 1 && this->m_rings[i-1]->used() == 0)
+              { this->m_rings.erase (this->m_rings.begin() + (i-1)); }
+            }
+            rings = this->m_rings;
+            lock.unlock();
+            this->Drain (rings, requested > this->m_flushCompleted);
+            rings.clear();
+            lock.lock();
+            if (requested > this->m_flushCompleted)
+            {
+              this->m_flushCompleted = requested;
+              this->m_flushed.notify_all();
+            }
+            if (stop)
+            { break; }
+            if (this->m_flushRequested == requested && !this->m_stop)
+            { this->m_wake.wait_for (lock, write_interval); }
+          }
+        }
+
+        /** Writes everything currently queued. */
+        void Drain (const std::vector<std::shared_ptr<log_ring> >& rings, bool flush)
+        {
+          this->m_logText.clear();
+          this->m_logSizes.clear();
+          this->m_consoleText.clear();
+          this->m_binaryText.clear();
+          this->m_binarySizes.clear();
+          this->m_available.clear();
+          for (const std::shared_ptr<log_ring>& ring : rings)
+          {
+            const size_t available = ring->used();
+            this->m_available.push_back (available);
+            size_t offset = 0;
+            while (offset < available)
+            {
+              record_header header;
+              ring->peek (offset, &header, sizeof(header));
+              offset += sizeof(header);
+              if (header.flags & TO_BINARY)
+              {
+                const size_t start = this->m_binaryText.size();
+                this->m_binaryText.resize (start + header.size);
+                ring->peek (offset, &this->m_binaryText[start], header.size);
+                this->m_binarySizes.push_back (header.size);
+                offset += header.size;
+                continue;
+              }
+              const size_t start = this->m_consoleText.size();
+              this->m_consoleText.resize (start + header.size);
+              ring->peek (offset, &this->m_consoleText[start], header.size);
+              offset += header.size;
+              if (header.flags & TO_LOG)
+              {
+                this->m_logText.append (this->m_consoleText, start, header.size);
+                this->m_logSizes.push_back (header.size);
+              }
+              if (!(header.flags & TO_CONSOLE))
+              { this->m_consoleText.resize (start); }
+            }
+          }
+          std::lock_guard<std::mutex> lock (this->m_owner->m_outputMutex);
+          // Append messages one by one, so that the history can discard
+          // whole messages.
+          const char* text = this->m_logText.data();
+          for (size_t size : this->m_logSizes)
+          {
+            this->m_owner->m_history.Append (text, size);
+            text += size;
+          }
+          if (!this->m_consoleText.empty())
+          {
+            this->m_owner->m_console->write (this->m_consoleText.data(), this->m_consoleText.size());
+            this->m_owner->m_console->flush();
+          }
+          else if (flush)
+          { this->m_owner->m_console->flush(); }
+          if (this->m_owner->m_binary)
+          {
+            const char* record = this->m_binaryText.data();
+            for (size_t size : this->m_binarySizes)
+            {
+              this->m_owner->WriteBinaryRecord (record, size);
+              record += size;
+            }
+            if (!this->m_binarySizes.empty() || flush)
+            { this->m_owner->m_binary->flush(); }
+          }
+          // Release the queues only now, so that a message too big to be
+          // queued, which waits for its thread's queue to empty, is not
+          // written before the messages that were queued ahead of it.
+          for (size_t i=0; i<rings.size(); ++i)
+          { rings[i]->consume (this->m_available[i]); }
+        }
+
+        logger* m_owner;
+        const uint64_t m_id;
+        std::mutex m_mutex;   // Guards the members below.
+        std::condition_variable m_wake;
+        std::condition_variable m_flushed;
+        std::vector<std::shared_ptr<log_ring> > m_rings;
+        uint64_t m_flushRequested;
+        uint64_t m_flushCompleted;
+        bool m_stop;
+        std::string m_logText;       // Background thread only.
+        std::vector<size_t> m_logSizes;  // Background thread only.
+        std::string m_consoleText;   // Background thread only.
+        std::string m_binaryText;    // Background thread only.
+        std::vector<size_t> m_binarySizes;  // Background thread only.
+        std::vector<size_t> m_available;    // Background thread only.
+        std::thread m_thread;
+    };
+
+    //-----------------------------------------------------------------------
+    log_buffer::log_buffer ()
+      :
+      m_storage (256),
+      m_stream (this)
+    {
+      this->setp (&this->m_storage[0], &this->m_storage[0] + this->m_storage.size());
+    }
+
+    log_buffer& log_buffer::for_thread ()
+    {
+      thread_local log_buffer buffer;
+      return buffer;
+    }
+
+    void log_buffer::reserve (size_t n)
+    {
+      const size_t used = this->size();
+      if (used + n <= this->m_storage.size())
+      { return; }
+      this->m_storage.resize (std::max (2*this->m_storage.size(), used + n));
+      this->setp (&this->m_storage[0], &this->m_storage[0] + this->m_storage.size());
+      this->pbump ((int)used);
+    }
+
+    log_buffer::int_type log_buffer::overflow (int_type c)
+    {
+      if (traits_type::eq_int_type (c, traits_type::eof()))
+      { return traits_type::not_eof (c); }
+      this->reserve (1);
+      *this->pptr() = traits_type::to_char_type (c);
+      this->pbump (1);
+      return c;
+    }
+
+    std::streamsize log_buffer::xsputn (const char* s, std::streamsize n)
+    {
+      this->reserve ((size_t)n);
+      memcpy (this->pptr(), s, (size_t)n);
+      this->pbump ((int)n);
+      return n;
+    }
+
+    //-----------------------------------------------------------------------
+    log_history::log_history ()
+      :
+      m_begin (0),
+      m_end (0),
+      m_maxBytes (size_t(64) << 20),
+      m_maxMessages (0),
+      m_spillBytes (0),
+      m_maxSpillBytes (0),
+      m_maxSpillFiles (0)
+    {}
+
+    log_history::~log_history ()
+    {
+      while (!this->m_messages.empty())
+      {
+        this->m_messages.pop_front();
+        this->Discard (this->m_messages.empty() ? this->m_end : this->m_messages.front());
+      }
+    }
+
+    void log_history::SetLimits (size_t maxBytes, size_t maxMessages)
+    {
+      this->m_maxBytes = maxBytes;
+      this->m_maxMessages = maxMessages;
+      while (!this->m_messages.empty()
+             && ((maxBytes && this->m_end - this->m_begin > maxBytes)
+                 || (maxMessages && this->m_messages.size() > maxMessages)))
+      {
+        this->m_messages.pop_front();
+        this->Discard (this->m_messages.empty() ? this->m_end : this->m_messages.front());
+      }
+      if (maxBytes && this->m_buffer.size() > maxBytes)
+      { this->Reallocate (maxBytes); }
+    }
+
+    void log_history::SetSpillFile (const std::string& filename,
+                                    size_t maxFileBytes,
+                                    int maxFiles)
+    {
+      if (this->m_spill.is_open())
+      { this->m_spill.close(); }
+      this->m_spillName = filename;
+      this->m_spillBytes = 0;
+      this->m_maxSpillBytes = maxFileBytes;
+      this->m_maxSpillFiles = maxFiles;
+      if (!filename.empty())
+      { this->m_spill.open (filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary); }
+    }
+
+    void log_history::Append (const char* s, size_t n)
+    {
+      if (n == 0)
+      { return; }
+      if (this->m_maxBytes && n > this->m_maxBytes)
+      {
+        // Only the end of the message fits.
+        this->m_messages.clear();
+        this->Discard (this->m_end);
+        this->Spill (s, n - this->m_maxBytes);
+        this->m_begin = this->m_end = this->m_end + (n - this->m_maxBytes);
+        s += n - this->m_maxBytes;
+        n = this->m_maxBytes;
+      }
+      while (!this->m_messages.empty()
+             && ((this->m_maxBytes && this->m_end + n - this->m_begin > this->m_maxBytes)
+                 || (this->m_maxMessages && this->m_messages.size() >= this->m_maxMessages)))
+      {
+        this->m_messages.pop_front();
+        this->Discard (this->m_messages.empty() ? this->m_end : this->m_messages.front());
+      }
+      const size_t needed = this->m_end + n - this->m_begin;
+      if (needed > this->m_buffer.size())
+      {
+        size_t capacity = std::max (2*this->m_buffer.size(), std::max (needed, size_t(4096)));
+        if (this->m_maxBytes)
+        { capacity = std::min (capacity, this->m_maxBytes); }
+        this->Reallocate (capacity);
+      }
+      const size_t offset = this->m_end % this->m_buffer.size();
+      const size_t first = std::min (n, this->m_buffer.size() - offset);
+      memcpy (&this->m_buffer[offset], s, first);
+      memcpy (&this->m_buffer[0], s + first, n - first);
+      this->m_messages.push_back (this->m_end);
+      this->m_end += n;
+    }
+
+    std::string log_history::Get () const
+    {
+      std::string text;
+      this->ReadSince (this->m_begin, text);
+      return text;
+    }
+
+    uint64_t log_history::ReadSince (uint64_t cursor, std::string& text) const
+    {
+      const uint64_t from = std::min (std::max (cursor, this->m_begin), this->m_end);
+      const size_t start = text.size();
+      text.resize (start + (this->m_end - from));
+      this->Copy (from, this->m_end, text.empty() ? NULL : &text[start]);
+      return this->m_end;
+    }
+
+    void log_history::Copy (uint64_t from, uint64_t to, char* p) const
+    {
+      if (from == to)
+      { return; }
+      const size_t offset = from % this->m_buffer.size();
+      const size_t n = to - from;
+      const size_t first = std::min (n, this->m_buffer.size() - offset);
+      memcpy (p, &this->m_buffer[offset], first);
+      memcpy (p + first, &this->m_buffer[0], n - first);
+    }
+
+    void log_history::Reallocate (size_t capacity)
+    {
+      const std::string text = this->Get();
+      this->m_buffer.assign (capacity, 0);
+      if (!text.empty())
+      {
+        const size_t offset = this->m_begin % capacity;
+        const size_t first = std::min (text.size(), capacity - offset);
+        memcpy (&this->m_buffer[offset], text.data(), first);
+        memcpy (&this->m_buffer[0], text.data() + first, text.size() - first);
+      }
+    }
+
+    void log_history::Discard (uint64_t position)
+    {
+      if (this->m_spill.is_open() && position > this->m_begin)
+      {
+        std::vector<char> text (position - this->m_begin);
+        this->Copy (this->m_begin, position, &text[0]);
+        this->Spill (&text[0], text.size());
+      }
+      this->m_begin = position;
+    }
+
+    void log_history::Spill (const char* s, size_t n)
+    {
+      if (!this->m_spill.is_open() || n == 0)
+      { return; }
+      if (this->m_spillBytes > 0 && this->m_spillBytes + n > this->m_maxSpillBytes)
+      { this->Rotate(); }
+      this->m_spill.write (s, n);
+      this->m_spill.flush();
+      this->m_spillBytes += n;
+    }
+
+    void log_history::Rotate ()
+    {
+      this->m_spill.close();
+      const std::string& name = this->m_spillName;
+      if (this->m_maxSpillFiles > 0)
+      {
+        std::remove ((name + "." + std::to_string (this->m_maxSpillFiles)).c_str());
+        for (int i=this->m_maxSpillFiles-1; i>0; --i)
+        {
+          std::rename ((name + "." + std::to_string (i)).c_str(),
+                       (name + "." + std::to_string (i+1)).c_str());
+        }
+        std::rename (name.c_str(), (name + ".1").c_str());
+      }
+      this->m_spill.open (name.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+      this->m_spillBytes = 0;
+    }
+
+    //-----------------------------------------------------------------------
+    log_message::log_message (logger& owner, LogLevel_t level)
+      :
+      m_owner (owner),
+      m_buffer (NULL),
+      m_start (0),
+      m_toLog (level >= owner.GetHistoryLevel()),
+      m_toConsole (level >= owner.GetConsoleLevel())
+    {
+      if (this->m_toLog || this->m_toConsole)
+      {
+        this->m_buffer = &log_buffer::for_thread();
+        this->m_start = this->m_buffer->size();
+      }
+    }
+
+    log_message::~log_message ()
+    {
+      if (this->m_buffer)
+      {
+        this->m_owner.Commit (this->m_buffer->data() + this->m_start,
+                              this->m_buffer->size() - this->m_start,
+                              this->m_toLog, this->m_toConsole);
+        this->m_buffer->truncate (this->m_start);
+      }
+    }
+
+    //-----------------------------------------------------------------------
+    logger::logger ()
+      :
+      m_logLevel (IMPORTANT),
+      m_consoleLevel (INFORMATIVE),
+      m_historyLevel (INFORMATIVE),
+      m_suppress (false),
+      m_console (&std::cout),
+      m_binary (NULL),
+      m_binaryEnabled (false)
+    {}
+
+    logger::~logger ()
+    {
+      // Stops the background thread after writing everything.
+      this->m_async.reset();
+      if (this->m_binary)
+      {
+        this->WriteBinaryClock();
+        this->m_binary->flush();
+      }
+    }
+
+    void logger::SetConsoleStream (std::ostream& stream)
+    {
+      this->Flush();
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->m_console = &stream;
+    }
+
+    std::string logger::GetLog ()
+    {
+      if (this->m_async)
+      { this->m_async->Flush(); }
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      return this->m_history.Get();
+    }
+
+    uint64_t logger::ReadLog (uint64_t cursor, std::string& text)
+    {
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      return this->m_history.ReadSince (cursor, text);
+    }
+
+    void logger::SetHistoryLimits (size_t maxBytes, size_t maxMessages)
+    {
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->m_history.SetLimits (maxBytes, maxMessages);
+    }
+
+    void logger::SetHistoryFile (const std::string& filename,
+                                 size_t maxFileBytes,
+                                 int maxFiles)
+    {
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->m_history.SetSpillFile (filename, maxFileBytes, maxFiles);
+    }
+
+    void logger::SetAsynchronous (bool asynchronous)
+    {
+      if (asynchronous == this->GetAsynchronous())
+      { return; }
+      if (asynchronous)
+      { this->m_async.reset (new log_async_writer (this)); }
+      else
+      { this->m_async.reset(); }
+    }
+
+    void logger::SetBinaryStream (std::ostream* stream)
+    {
+      this->Flush();
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->m_binary = stream;
+      this->m_binaryDefined.clear();
+      if (stream)
+      {
+        const uint32_t byte_order = 0x01020304;
+        stream->write (binary_log_magic, sizeof(binary_log_magic) - 1);
+        stream->write ((const char*)&byte_order, sizeof(byte_order));
+        this->WriteBinaryClock();
+      }
+      this->m_binaryEnabled = (stream != NULL);
+    }
+
+    void logger::Flush ()
+    {
+      if (this->m_async)
+      { this->m_async->Flush(); }
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->m_console->flush();
+      if (this->m_binary)
+      {
+        // Each clock record improves the conversion of time stamps.
+        this->WriteBinaryClock();
+        this->m_binary->flush();
+      }
+    }
+
+    void logger::Commit (const char* s, size_t n, bool toLog, bool toConsole)
+    {
+      if (n == 0 || !(toLog || toConsole))
+      { return; }
+      const unsigned int flags = (toLog ? TO_LOG : 0) | (toConsole ? TO_CONSOLE : 0);
+      if (this->m_async)
+      {
+        this->m_async->Write (s, n, flags);
+        return;
+      }
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->Output (s, n, flags);
+    }
+
+    void logger::CommitBinary (const char* s, size_t n)
+    {
+      if (this->m_async)
+      {
+        this->m_async->Write (s, n, TO_BINARY);
+        return;
+      }
+      std::lock_guard<std::mutex> lock (this->m_outputMutex);
+      this->Output (s, n, TO_BINARY);
+    }
+
+    void logger::Output (const char* s, size_t n, unsigned int destinations)
+    {
+      if (destinations & TO_BINARY)
+      {
+        if (this->m_binary)
+        { this->WriteBinaryRecord (s, n); }
+        return;
+      }
+      if (destinations & TO_LOG)
+      { this->m_history.Append (s, n); }
+      if (destinations & TO_CONSOLE)
+      {
+        this->m_console->write (s, n);
+        this->m_console->flush();
+      }
+    }
+
+    void logger::WriteBinaryRecord (const char* s, size_t n)
+    {
+      // Write the definition of the format before its first use.
+      uint32_t id;
+      memcpy (&id, s + 1, sizeof(id));
+      if (id >= this->m_binaryDefined.size())
+      { this->m_binaryDefined.resize (id + 1, false); }
+      if (!this->m_binaryDefined[id])
+      {
+        std::string format, tags;
+        binary_log_format::Lookup (id, format, tags);
+        const char type = BINARY_LOG_DEFINE;
+        const uint32_t format_size = (uint32_t)format.size();
+        const uint32_t tags_size = (uint32_t)tags.size();
+        this->m_binary->write (&type, 1);
+        this->m_binary->write ((const char*)&id, sizeof(id));
+        this->m_binary->write ((const char*)&format_size, sizeof(format_size));
+        this->m_binary->write (format.data(), format_size);
+        this->m_binary->write ((const char*)&tags_size, sizeof(tags_size));
+        this->m_binary->write (tags.data(), tags_size);
+        this->m_binaryDefined[id] = true;
+      }
+      this->m_binary->write (s, n);
+    }
+
+    void logger::WriteBinaryClock ()
+    {
+      const char type = BINARY_LOG_CLOCK;
+      const uint64_t timestamp = binary_log_timestamp();
+      const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds> (
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+      this->m_binary->write (&type, 1);
+      this->m_binary->write ((const char*)&timestamp, sizeof(timestamp));
+      this->m_binary->write ((const char*)&ns, sizeof(ns));
+    }
+
+  }  // namespace io
+
+}  // namespace n88
@@ -0,0 +1,627 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+#include "n88util/profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace n88
+{
+
+  namespace
+  {
+
+    enum counter_t {
+      CYCLES = 0,
+      INSTRUCTIONS,
+      CACHE_MISSES,
+      NUMBER_OF_COUNTERS
+    };
+
+    // Bytes transferred from memory for each last level cache miss.
+    const double cache_line_size = 64;
+
+    /** Hardware performance counters of the calling thread. */
+    class perf_counters
+    {
+      public:
+
+        perf_counters ()
+        {
+          for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+          { this->m_fd[i] = -1; }
+        }
+
+        ~perf_counters ()
+        {
+#ifdef __linux__
+          for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+          {
+            if (this->m_fd[i] >= 0)
+            { close (this->m_fd[i]); }
+          }
+#endif
+        }
+
+        /** Opens the counters as a group, so that they are read together.
+          * Returns false if the cycle and instruction counters are not
+          * available; the cache miss counter is optional.
+          */
+        bool open ()
+        {
+#ifdef __linux__
+          const uint64_t configs[NUMBER_OF_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES };
+          for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+          {
+            perf_event_attr attr;
+            memset (&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = (i == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+            this->m_fd[i] = (int)syscall (__NR_perf_event_open, &attr, 0, -1,
+                                          i == 0 ? -1 : this->m_fd[0], 0);
+            if (this->m_fd[i] >= 0)
+            { ioctl (this->m_fd[i], PERF_EVENT_IOC_ID, &this->m_id[i]); }
+            else if (i < CACHE_MISSES)
+            { return false; }
+          }
+          ioctl (this->m_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+          ioctl (this->m_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+          return true;
+#else
+          return false;
+#endif
+        }
+
+        /** Reads the counters.  Counters that are not available read 0. */
+        void read (uint64_t values[NUMBER_OF_COUNTERS])
+        {
+          for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+          { values[i] = 0; }
+#ifdef __linux__
+          // nr, followed by value and id for each counter in the group.
+          uint64_t data[1 + 2*NUMBER_OF_COUNTERS];
+          const ssize_t n = ::read (this->m_fd[0], data, sizeof(data));
+          if (n < (ssize_t)sizeof(uint64_t))
+          { return; }
+          for (uint64_t j=0; j<data[0] && j<NUMBER_OF_COUNTERS; ++j)
+          {
+            for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+            {
+              if (this->m_fd[i] >= 0 && this->m_id[i] == data[2 + 2*j])
+              { values[i] = data[1 + 2*j]; }
+            }
+          }
+#endif
+        }
+
+      protected:
+
+        int m_fd[NUMBER_OF_COUNTERS];
+        uint64_t m_id[NUMBER_OF_COUNTERS];
+    };
+
+    struct region_stats
+    {
+      region_stats ()
+        :
+        count (0),
+        total (0),
+        self (0),
+        min (std::numeric_limits<int64_t>::max()),
+        max (0),
+        counted (0),
+        counted_time (0)
+      {
+        for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+        { this->counters[i] = 0; }
+      }
+
+      void add (const region_stats& other)
+      {
+        this->count += other.count;
+        this->total += other.total;
+        this->self += other.self;
+        this->min = std::min (this->min, other.min);
+        this->max = std::max (this->max, other.max);
+        this->counted += other.counted;
+        this->counted_time += other.counted_time;
+        for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+        { this->counters[i] += other.counters[i]; }
+      }
+
+      uint64_t count;
+      int64_t total;
+      int64_t self;
+      int64_t min;
+      int64_t max;
+      // Calls for which counters were read, and their total time.
+      uint64_t counted;
+      int64_t counted_time;
+      uint64_t counters[NUMBER_OF_COUNTERS];
+    };
+
+    // A region on a particular path of nested regions.
+    struct path_node
+    {
+      uint32_t region;
+      std::vector<uint32_t> children;
+      region_stats stats;
+    };
+
+    // An active region.
+    struct frame
+    {
+      uint32_t node;
+      int64_t start;
+      int64_t child_time;
+      bool counted;
+      uint64_t counters[NUMBER_OF_COUNTERS];
+    };
+
+    struct trace_event
+    {
+      uint32_t region;
+      int64_t start;
+      int64_t duration;
+    };
+
+    /** The profile of one thread.
+      *
+      * Only the owning thread modifies it.  Changes to nodes and events
+      * are made with the mutex locked, so that they can be read by other
+      * threads; the stack is private to the owning thread.
+      */
+    struct thread_profile
+    {
+      std::mutex mutex;
+      size_t index;
+      std::vector<path_node> nodes;  // nodes[0] is the root.
+      std::vector<frame> stack;
+      std::vector<trace_event> events;
+      // The counters are opened on first use.
+      enum {COUNTERS_UNTRIED, COUNTERS_OPEN, COUNTERS_FAILED} counters_state;
+      perf_counters counters;
+    };
+
+    // The events of a thread that has exited.
+    struct retired_events
+    {
+      size_t index;
+      std::vector<trace_event> events;
+    };
+
+    std::mutex registry_mutex;
+    std::vector<const char*> region_names;
+    std::vector<std::shared_ptr<thread_profile> > threads;
+    size_t next_thread_index = 0;
+    // The nodes of threads that have exited, combined by path, and their
+    // events.
+    std::vector<path_node> retired_nodes (1);
+    std::vector<retired_events> retired_traces;
+    std::atomic<bool> trace_enabled (false);
+    std::atomic<size_t> trace_limit (0);
+    std::atomic<bool> counters_enabled (false);
+
+    // Adds the subtree of source at node to target at target_node.
+    void retire_nodes (std::vector<path_node>& target, uint32_t target_node,
+                       const std::vector<path_node>& source, uint32_t node)
+    {
+      target[target_node].stats.add (source[node].stats);
+      for (uint32_t child : source[node].children)
+      {
+        uint32_t match = 0;
+        for (uint32_t c : target[target_node].children)
+        {
+          if (target[c].region == source[child].region)
+          { match = c; break; }
+        }
+        if (match == 0)
+        {
+          match = (uint32_t)target.size();
+          target.push_back (path_node());
+          target.back().region = source[child].region;
+          target[target_node].children.push_back (match);
+        }
+        retire_nodes (target, match, source, child);
+      }
+    }
+
+    /** Owns the profile of a thread.  When the thread exits, its timings
+      * and events are kept with those of other exited threads, and the
+      * profile, including its counters, is released.
+      */
+    struct thread_profile_owner
+    {
+      ~thread_profile_owner ()
+      {
+        if (!this->profile)
+        { return; }
+        std::lock_guard<std::mutex> lock (registry_mutex);
+        std::lock_guard<std::mutex> thread_lock (this->profile->mutex);
+        retire_nodes (retired_nodes, 0, this->profile->nodes, 0);
+        if (!this->profile->events.empty())
+        {
+          retired_traces.push_back (retired_events());
+          retired_traces.back().index = this->profile->index;
+          retired_traces.back().events.swap (this->profile->events);
+        }
+        threads.erase (std::find (threads.begin(), threads.end(), this->profile));
+      }
+
+      std::shared_ptr<thread_profile> profile;
+    };
+
+    thread_local thread_profile_owner this_thread_profile;
+
+    thread_profile& get_thread_profile ()
+    {
+      if (!this_thread_profile.profile)
+      {
+        std::shared_ptr<thread_profile> profile (new thread_profile);
+        profile->nodes.resize (1);
+        profile->nodes[0].region = std::numeric_limits<uint32_t>::max();
+        profile->counters_state = thread_profile::COUNTERS_UNTRIED;
+        std::lock_guard<std::mutex> lock (registry_mutex);
+        profile->index = next_thread_index++;
+        threads.push_back (profile);
+        this_thread_profile.profile = profile;
+      }
+      return *this_thread_profile.profile;
+    }
+
+    // The nodes of all threads combined by path.
+    struct merged_node
+    {
+      uint32_t region;
+      region_stats stats;
+      std::vector<merged_node> children;
+    };
+
+    void merge (merged_node& target, const std::vector<path_node>& nodes, uint32_t node)
+    {
+      target.stats.add (nodes[node].stats);
+      for (uint32_t child : nodes[node].children)
+      {
+        merged_node* match = NULL;
+        for (merged_node& m : target.children)
+        {
+          if (m.region == nodes[child].region)
+          { match = &m; break; }
+        }
+        if (!match)
+        {
+          target.children.push_back (merged_node());
+          match = &target.children.back();
+          match->region = nodes[child].region;
+        }
+        merge (*match, nodes, child);
+      }
+    }
+
+    bool has_calls (const merged_node& node)
+    {
+      if (node.stats.count > 0)
+      { return true; }
+      for (const merged_node& child : node.children)
+      {
+        if (has_calls (child))
+        { return true; }
+      }
+      return false;
+    }
+
+    size_t name_width (const merged_node& node, size_t depth)
+    {
+      size_t width = 0;
+      for (const merged_node& child : node.children)
+      {
+        width = std::max (width, 2*depth + std::string (region_names[child.region]).size());
+        width = std::max (width, name_width (child, depth + 1));
+      }
+      return width;
+    }
+
+    bool has_counters (const merged_node& node)
+    {
+      if (node.stats.counted > 0)
+      { return true; }
+      for (const merged_node& child : node.children)
+      {
+        if (has_counters (child))
+        { return true; }
+      }
+      return false;
+    }
+
+    void report_children (std::ostream& out, const merged_node& node, size_t depth, size_t width,
+                          bool counters)
+    {
+      for (const merged_node& child : node.children)
+      {
+        if (!has_calls (child))
+        { continue; }
+        const region_stats& s = child.stats;
+        const std::string name = std::string (2*depth, ' ') + region_names[child.region];
+        char line[128];
+        snprintf (line, sizeof(line), " %10llu %12.6f %12.6f %12.6f %12.6f %12.6f\n",
+                  (unsigned long long)s.count,
+                  s.total * 1E-9,
+                  s.self * 1E-9,
+                  s.count ? (s.total * 1E-6) / s.count : 0.0,
+                  s.count ? s.min * 1E-6 : 0.0,
+                  s.max * 1E-6);
+        out << name << std::string (width - name.size(), ' ');
+        if (counters)
+        {
+          // Remove the newline.
+          line[strlen (line) - 1] = '\0';
+          out << line;
+          char metrics[64];
+          if (s.counted > 0 && s.counters[CYCLES] > 0)
+          {
+            snprintf (metrics, sizeof(metrics), " %6.2f %12llu %8.3f\n",
+                      double (s.counters[INSTRUCTIONS]) / s.counters[CYCLES],
+                      (unsigned long long)s.counters[CACHE_MISSES],
+                      s.counted_time > 0 ? s.counters[CACHE_MISSES] * cache_line_size / s.counted_time : 0.0);
+          }
+          else
+          { snprintf (metrics, sizeof(metrics), " %6s %12s %8s\n", "-", "-", "-"); }
+          out << metrics;
+        }
+        else
+        { out << line; }
+        report_children (out, child, depth + 1, width, counters);
+      }
+    }
+
+    void write_json_string (std::ostream& out, const char* s)
+    {
+      out << '"';
+      for (; *s; ++s)
+      {
+        if (*s == '"' || *s == '\\')
+        { out << '\\' << *s; }
+        else if ((unsigned char)*s < 0x20)
+        {
+          char escaped[8];
+          snprintf (escaped, sizeof(escaped), "\\u%04x", (unsigned int)(unsigned char)*s);
+          out << escaped;
+        }
+        else
+        { out << *s; }
+      }
+      out << '"';
+    }
+
+    void write_thread_events (std::ostream& out, size_t index, const std::vector<trace_event>& events,
+                              int64_t origin, bool& first)
+    {
+      char numbers[128];
+      snprintf (numbers, sizeof(numbers), "%zu", index);
+      out << (first ? "" : ",")
+          << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << numbers
+          << ",\"args\":{\"name\":\"thread " << numbers << "\"}}";
+      first = false;
+      for (const trace_event& e : events)
+      {
+        out << ",\n{\"name\":";
+        write_json_string (out, region_names[e.region]);
+        snprintf (numbers, sizeof(numbers), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu}",
+                  (e.start - origin) * 1E-3, e.duration * 1E-3, index);
+        out << numbers;
+      }
+    }
+
+  }  // anonymous namespace
+
+  std::atomic<bool> profiler::m_enabled (false);
+
+  //-----------------------------------------------------------------------
+  void profiler::SetTraceEnabled (bool enabled, size_t maxEvents)
+  {
+    trace_limit.store (maxEvents, std::memory_order_relaxed);
+    trace_enabled.store (enabled, std::memory_order_relaxed);
+  }
+
+  bool profiler::GetTraceEnabled ()
+  { return trace_enabled.load (std::memory_order_relaxed); }
+
+  bool profiler::SetCountersEnabled (bool enabled)
+  {
+    if (enabled)
+    {
+      thread_profile& t = get_thread_profile();
+      if (t.counters_state == thread_profile::COUNTERS_UNTRIED)
+      {
+        t.counters_state = t.counters.open() ? thread_profile::COUNTERS_OPEN
+                                             : thread_profile::COUNTERS_FAILED;
+      }
+      if (t.counters_state == thread_profile::COUNTERS_FAILED)
+      { enabled = false; }
+    }
+    counters_enabled.store (enabled, std::memory_order_relaxed);
+    return enabled;
+  }
+
+  bool profiler::GetCountersEnabled ()
+  { return counters_enabled.load (std::memory_order_relaxed); }
+
+  void profiler::Report (std::ostream& out)
+  {
+    std::lock_guard<std::mutex> lock (registry_mutex);
+    merged_node root;
+    merge (root, retired_nodes, 0);
+    for (const std::shared_ptr<thread_profile>& t : threads)
+    {
+      std::lock_guard<std::mutex> thread_lock (t->mutex);
+      merge (root, t->nodes, 0);
+    }
+    const size_t width = std::max (size_t(6), name_width (root, 0));
+    char header[128];
+    snprintf (header, sizeof(header), " %10s %12s %12s %12s %12s %12s\n",
+              "Calls", "Total (s)", "Self (s)", "Mean (ms)", "Min (ms)", "Max (ms)");
+    const bool counters = has_counters (root);
+    if (counters)
+    {
+      header[strlen (header) - 1] = '\0';
+      out << "Region" << std::string (width - 6, ' ') << header
+          << "    IPC   LLC misses     GB/s\n";
+    }
+    else
+    { out << "Region" << std::string (width - 6, ' ') << header; }
+    report_children (out, root, 0, width, counters);
+  }
+
+  void profiler::WriteChromeTrace (std::ostream& out)
+  {
+    std::lock_guard<std::mutex> lock (registry_mutex);
+    // Times are relative to the earliest event.
+    int64_t origin = std::numeric_limits<int64_t>::max();
+    for (const retired_events& r : retired_traces)
+    {
+      for (const trace_event& e : r.events)
+      { origin = std::min (origin, e.start); }
+    }
+    for (const std::shared_ptr<thread_profile>& t : threads)
+    {
+      std::lock_guard<std::mutex> thread_lock (t->mutex);
+      for (const trace_event& e : t->events)
+      { origin = std::min (origin, e.start); }
+    }
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const retired_events& r : retired_traces)
+    { write_thread_events (out, r.index, r.events, origin, first); }
+    for (const std::shared_ptr<thread_profile>& t : threads)
+    {
+      std::lock_guard<std::mutex> thread_lock (t->mutex);
+      if (!t->events.empty())
+      { write_thread_events (out, t->index, t->events, origin, first); }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+  void profiler::Reset ()
+  {
+    std::lock_guard<std::mutex> lock (registry_mutex);
+    retired_nodes.resize (1);
+    retired_nodes[0] = path_node();
+    retired_traces.clear();
+    for (const std::shared_ptr<thread_profile>& t : threads)
+    {
+      std::lock_guard<std::mutex> thread_lock (t->mutex);
+      for (path_node& node : t->nodes)
+      { node.stats = region_stats(); }
+      t->events.clear();
+    }
+  }
+
+  //-----------------------------------------------------------------------
+  profile_region::profile_region (const char* name)
+    :
+    m_name (name)
+  {
+    std::lock_guard<std::mutex> lock (registry_mutex);
+    this->m_id = (uint32_t)region_names.size();
+    region_names.push_back (name);
+  }
+
+  //-----------------------------------------------------------------------
+  void profile_scope::Enter (const profile_region& region)
+  {
+    thread_profile& t = get_thread_profile();
+    const uint32_t parent = t.stack.empty() ? 0 : t.stack.back().node;
+    uint32_t node = 0;
+    for (uint32_t child : t.nodes[parent].children)
+    {
+      if (t.nodes[child].region == region.id())
+      { node = child; break; }
+    }
+    if (node == 0)
+    {
+      std::lock_guard<std::mutex> lock (t.mutex);
+      node = (uint32_t)t.nodes.size();
+      t.nodes.push_back (path_node());
+      t.nodes.back().region = region.id();
+      t.nodes[parent].children.push_back (node);
+    }
+    frame f;
+    f.node = node;
+    f.child_time = 0;
+    f.counted = false;
+    if (counters_enabled.load (std::memory_order_relaxed))
+    {
+      if (t.counters_state == thread_profile::COUNTERS_UNTRIED)
+      {
+        t.counters_state = t.counters.open() ? thread_profile::COUNTERS_OPEN
+                                             : thread_profile::COUNTERS_FAILED;
+      }
+      f.counted = (t.counters_state == thread_profile::COUNTERS_OPEN);
+    }
+    t.stack.push_back (f);
+    this->m_active = true;
+    // Read the counters and clock last, so that the above is not included.
+    frame& top = t.stack.back();
+    if (top.counted)
+    { t.counters.read (top.counters); }
+    top.start = profiler_clock();
+  }
+
+  void profile_scope::Exit ()
+  {
+    const int64_t end = profiler_clock();
+    thread_profile& t = *this_thread_profile.profile;
+    uint64_t counters[NUMBER_OF_COUNTERS];
+    if (t.stack.back().counted)
+    { t.counters.read (counters); }
+    const frame f = t.stack.back();
+    t.stack.pop_back();
+    const int64_t elapsed = end - f.start;
+    if (!t.stack.empty())
+    { t.stack.back().child_time += elapsed; }
+    std::lock_guard<std::mutex> lock (t.mutex);
+    region_stats& s = t.nodes[f.node].stats;
+    ++s.count;
+    s.total += elapsed;
+    s.self += elapsed - f.child_time;
+    s.min = std::min (s.min, elapsed);
+    s.max = std::max (s.max, elapsed);
+    if (f.counted)
+    {
+      ++s.counted;
+      s.counted_time += elapsed;
+      for (int i=0; i<NUMBER_OF_COUNTERS; ++i)
+      { s.counters[i] += counters[i] - f.counters[i]; }
+    }
+    if (trace_enabled.load (std::memory_order_relaxed)
+        && t.events.size() < trace_limit.load (std::memory_order_relaxed))
+    {
+      trace_event e;
+      e.region = t.nodes[f.node].region;
+      e.start = f.start;
+      e.duration = elapsed;
+      t.events.push_back (e);
+    }
+  }
+
+}  // namespace n88
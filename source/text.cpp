@@ -2,28 +2,234 @@
 // See LICENSE for details.
 
 #include "n88util/text.hpp"
-#include <boost/tokenizer.hpp>
-#include <boost/algorithm/string.hpp>
+#include <cstring>
+
+// SIMD kernels are compiled with per-function target attributes, so no
+// special compiler flags are required, and are selected at run time
+// according to the capabilities of the CPU.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define N88UTIL_TEXT_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace n88util
 {
 
+  namespace
+  {
+
+    // Same characters as std::isspace in the C locale.
+    const char whitespace[] = " \t\n\v\f\r";
+
+    // These are function-local statics, so that they are initialized
+    // before first use even when called during the static initialization
+    // of another translation unit.
+    const separator_set& whitespace_set()
+      {
+      static const separator_set separators(whitespace);
+      return separators;
+      }
+
+    const separator_set& default_argument_separators()
+      {
+      static const separator_set separators(" \t,");
+      return separators;
+      }
+
+    const separator_set& default_trim_separators()
+      {
+      static const separator_set separators(",");
+      return separators;
+      }
+
+    //---------------------------------------------------------------------
+    // Returns a pointer to the first character in [begin,end) that is a
+    // separator (if match is true) or is not a separator (if match is
+    // false), or end if there is none.
+    template <bool match>
+    const char* find_scalar(const bool* table, const unsigned char*,
+                            const char* begin, const char* end)
+      {
+      while (begin != end && table[(unsigned char)*begin] != match)
+        {
+        ++begin;
+        }
+      return begin;
+      }
+
+#ifdef N88UTIL_TEXT_X86_SIMD
+
+    // The vector kernels look up the low nibble of each character in the
+    // nibble table of the separator_set, and the high nibble in this
+    // table; the AND of the two is non-zero only for separators.  This is
+    // the character classification technique used by simdjson.
+    const unsigned char high_nibble_bits[16] =
+      { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    //---------------------------------------------------------------------
+    template <bool match>
+    __attribute__((target("ssse3")))
+    const char* find_ssse3(const bool* table, const unsigned char* nibble_table,
+                           const char* begin, const char* end)
+      {
+      const __m128i lo_lookup = _mm_loadu_si128((const __m128i*)nibble_table);
+      const __m128i hi_lookup = _mm_loadu_si128((const __m128i*)high_nibble_bits);
+      const __m128i nibble = _mm_set1_epi8(0x0F);
+      for (; end - begin >= 16; begin += 16)
+        {
+        const __m128i c = _mm_loadu_si128((const __m128i*)begin);
+        const __m128i lo = _mm_shuffle_epi8(lo_lookup, _mm_and_si128(c, nibble));
+        const __m128i hi = _mm_shuffle_epi8(hi_lookup, _mm_and_si128(_mm_srli_epi16(c, 4), nibble));
+        const __m128i not_separator = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(not_separator);
+        if (match)
+          {
+          mask ^= 0xFFFF;
+          }
+        if (mask)
+          {
+          return begin + __builtin_ctz(mask);
+          }
+        }
+      return find_scalar<match>(table, nibble_table, begin, end);
+      }
+
+    //---------------------------------------------------------------------
+    template <bool match>
+    __attribute__((target("avx2")))
+    const char* find_avx2(const bool* table, const unsigned char* nibble_table,
+                          const char* begin, const char* end)
+      {
+      const __m256i lo_lookup = _mm256_broadcastsi128_si256(
+                                    _mm_loadu_si128((const __m128i*)nibble_table));
+      const __m256i hi_lookup = _mm256_broadcastsi128_si256(
+                                    _mm_loadu_si128((const __m128i*)high_nibble_bits));
+      const __m256i nibble = _mm256_set1_epi8(0x0F);
+      for (; end - begin >= 32; begin += 32)
+        {
+        const __m256i c = _mm256_loadu_si256((const __m256i*)begin);
+        const __m256i lo = _mm256_shuffle_epi8(lo_lookup, _mm256_and_si256(c, nibble));
+        const __m256i hi = _mm256_shuffle_epi8(hi_lookup, _mm256_and_si256(_mm256_srli_epi16(c, 4), nibble));
+        const __m256i not_separator = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(not_separator);
+        if (match)
+          {
+          mask = ~mask;
+          }
+        if (mask)
+          {
+          return begin + __builtin_ctz(mask);
+          }
+        }
+      return find_ssse3<match>(table, nibble_table, begin, end);
+      }
+
+#endif  // N88UTIL_TEXT_X86_SIMD
+
+    typedef const char* (*find_function_t)(const bool*, const unsigned char*,
+                                           const char*, const char*);
+
+    //---------------------------------------------------------------------
+    template <bool match>
+    find_function_t select_find()
+      {
+#ifdef N88UTIL_TEXT_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+        {
+        return find_avx2<match>;
+        }
+      if (__builtin_cpu_supports("ssse3"))
+        {
+        return find_ssse3<match>;
+        }
+#endif
+      return find_scalar<match>;
+      }
+
+  }  // anonymous namespace
+
+  //-----------------------------------------------------------------------
+  separator_set::separator_set(const char* separators)
+    {
+    memset(this->m_table, 0, sizeof(this->m_table));
+    memset(this->m_nibble_table, 0, sizeof(this->m_nibble_table));
+    this->m_ascii = true;
+    for (const char* c = separators; *c; ++c)
+      {
+      const unsigned char u = (unsigned char)*c;
+      this->m_table[u] = true;
+      if (u < 0x80)
+        {
+        this->m_nibble_table[u & 0x0F] |= (unsigned char)(1 << (u >> 4));
+        }
+      else
+        {
+        this->m_ascii = false;
+        }
+      }
+    }
+
+  //-----------------------------------------------------------------------
+  const char* separator_set::find_first(const char* begin, const char* end) const
+    {
+    static const find_function_t f = select_find<true>();
+    // Tokens are often short, so check the first character before paying
+    // for a vector load.
+    if (begin == end || this->contains(*begin))
+      {
+      return begin;
+      }
+    if (!this->m_ascii)
+      {
+      return find_scalar<true>(this->m_table, this->m_nibble_table, begin + 1, end);
+      }
+    return f(this->m_table, this->m_nibble_table, begin + 1, end);
+    }
+
+  //-----------------------------------------------------------------------
+  const char* separator_set::find_first_not(const char* begin, const char* end) const
+    {
+    static const find_function_t f = select_find<false>();
+    if (begin == end || !this->contains(*begin))
+      {
+      return begin;
+      }
+    if (!this->m_ascii)
+      {
+      return find_scalar<false>(this->m_table, this->m_nibble_table, begin + 1, end);
+      }
+    return f(this->m_table, this->m_nibble_table, begin + 1, end);
+    }
+
+  //-----------------------------------------------------------------------
+  std::string_view trim(std::string_view s)
+    {
+    const char* begin = s.data();
+    const char* end = begin + s.size();
+    const separator_set& separators = whitespace_set();
+    begin = separators.find_first_not(begin, end);
+    while (end != begin && separators.contains(end[-1]))
+      {
+      --end;
+      }
+    return std::string_view(begin, end - begin);
+    }
+
   //-----------------------------------------------------------------------
   void split_arguments(const std::string& s,
                        std::vector<std::string>& tokens,
                        const char* separators)
     {
+    tokens.clear();
+    const auto append = [&tokens](std::string_view t) { tokens.emplace_back(t); };
     if (separators == NULL)
       {
-      separators = " \t,";
+      for_each_argument(s, default_argument_separators(), append);
       }
-    boost::char_separator<char> sep(separators);
-    typedef boost::tokenizer<boost::char_separator<char> > tokenizer_t;
-    tokens.clear();
-    tokenizer_t tok(s, sep);
-    for (tokenizer_t::iterator t = tok.begin(); t != tok.end(); ++t)
+    else
       {
-      tokens.push_back(*t);
+      for_each_argument(s, separator_set(separators), append);
       }
     }
 
@@ -32,19 +238,66 @@ namespace n88util
                   std::vector<std::string>& tokens,
                   const char* separators)
     {
+    tokens.clear();
+    const auto append = [&tokens](std::string_view t) { tokens.emplace_back(t); };
+    if (separators == NULL)
+      {
+      for_each_trimmed(s, default_trim_separators(), append);
+      }
+    else
+      {
+      for_each_trimmed(s, separator_set(separators), append);
+      }
+    }
+
+  //-----------------------------------------------------------------------
+  void split_arguments(std::string_view s,
+                       std::vector<std::string_view>& tokens,
+                       const char* separators)
+    {
     if (separators == NULL)
       {
-      separators = ",";
+      split_arguments(s, tokens, default_argument_separators());
       }
-    typedef boost::char_separator<char> sep_t;
-    sep_t sep(separators, "", boost::keep_empty_tokens);
-    typedef boost::tokenizer<sep_t> tokenizer_t;
+    else
+      {
+      split_arguments(s, tokens, separator_set(separators));
+      }
+    }
+
+  //-----------------------------------------------------------------------
+  void split_arguments(std::string_view s,
+                       std::vector<std::string_view>& tokens,
+                       const separator_set& separators)
+    {
     tokens.clear();
-    tokenizer_t tok(s, sep);
-    for (tokenizer_t::iterator t = tok.begin(); t != tok.end(); ++t)
+    for_each_argument(s, separators,
+                      [&tokens](std::string_view t) { tokens.push_back(t); });
+    }
+
+  //-----------------------------------------------------------------------
+  void split_trim(std::string_view s,
+                  std::vector<std::string_view>& tokens,
+                  const char* separators)
+    {
+    if (separators == NULL)
+      {
+      split_trim(s, tokens, default_trim_separators());
+      }
+    else
       {
-      tokens.push_back(boost::algorithm::trim_copy(*t));
+      split_trim(s, tokens, separator_set(separators));
       }
     }
 
+  //-----------------------------------------------------------------------
+  void split_trim(std::string_view s,
+                  std::vector<std::string_view>& tokens,
+                  const separator_set& separators)
+    {
+    tokens.clear();
+    for_each_trimmed(s, separators,
+                     [&tokens](std::string_view t) { tokens.push_back(t); });
+    }
+
 }   // namespace n88util
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "n88util/ObjectGroup.hpp"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace n88;
+
+
+namespace
+{
+
+  std::atomic<int> live (0);
+
+  struct Counter
+  {
+    Counter () : value (42) { ++live; }
+    virtual ~Counter () { --live; }
+    int value;
+  };
+
+  struct Padding
+  {
+    Padding () : pad (1.0) {}
+    double pad;
+  };
+
+  // Counter is not the first base class, so is at an offset.
+  struct Derived : public Padding, public Counter
+  {
+    Derived () : extra (3) {}
+    int extra;
+  };
+
+  // Throws on the third construction.
+  std::atomic<int> throw_countdown (0);
+
+  struct Throwing : public Counter
+  {
+    Throwing ()
+    {
+      if (--throw_countdown == 0)
+        { throw std::runtime_error ("construction failed"); }
+    }
+  };
+
+  std::mutex threads_mutex;
+  std::set<std::thread::id> construction_threads;
+
+  struct Recording : public Counter
+  {
+    Recording ()
+    {
+      std::lock_guard<std::mutex> lock (threads_mutex);
+      construction_threads.insert (std::this_thread::get_id());
+    }
+  };
+
+}
+
+// Create a test fixture class.
+class ObjectGroupTests : public ::testing::Test
+{};
+
+// --------------------------------------------------------------------
+// test implementations
+
+TEST_F (ObjectGroupTests, construct)
+{
+  {
+    ObjectGroup<Counter> group (5);
+    ASSERT_TRUE (group.is_constructed());
+    ASSERT_EQ (group.size(), 5);
+    ASSERT_EQ (live, 5);
+    for (size_t i=0; i<group.size(); ++i)
+    {
+      ASSERT_EQ (group[i].value, 42);
+      ASSERT_EQ (size_t (&group[i]) % ObjectGroup<Counter>::cache_line_size, 0);
+    }
+    // Each object is on its own cache line.
+    ASSERT_EQ ((char*)&group[1] - (char*)&group[0], ObjectGroup<Counter>::cache_line_size);
+    group.destroy();
+    ASSERT_FALSE (group.is_constructed());
+    ASSERT_EQ (live, 0);
+    group.construct<Counter> (2);
+    ASSERT_EQ (live, 2);
+    ASSERT_THROW (group.construct<Counter> (2), n88_exception);
+  }
+  ASSERT_EQ (live, 0);
+}
+
+TEST_F (ObjectGroupTests, empty)
+{
+  ObjectGroup<Counter> group;
+  ASSERT_FALSE (group.is_constructed());
+  group.construct<Counter> (0);
+  ASSERT_EQ (group.size(), 0);
+  group.destroy();
+}
+
+TEST_F (ObjectGroupTests, derived)
+{
+  {
+    ObjectGroup<Counter> group;
+    group.construct<Derived> (3);
+    ASSERT_EQ (live, 3);
+    for (size_t i=0; i<group.size(); ++i)
+    {
+      ASSERT_EQ (group[i].value, 42);
+      Derived* d = dynamic_cast<Derived*> (&group[i]);
+      ASSERT_TRUE (d != NULL);
+      ASSERT_EQ (d->extra, 3);
+      ASSERT_EQ (d->pad, 1.0);
+    }
+  }
+  ASSERT_EQ (live, 0);
+}
+
+TEST_F (ObjectGroupTests, construct_throws)
+{
+  ObjectGroup<Counter> group;
+  throw_countdown = 3;
+  ASSERT_THROW (group.construct<Throwing> (5), std::runtime_error);
+  ASSERT_EQ (live, 0);
+  ASSERT_FALSE (group.is_constructed());
+}
+
+TEST_F (ObjectGroupTests, construct_parallel)
+{
+  {
+    construction_threads.clear();
+    ObjectGroup<Counter> group;
+    group.construct_parallel<Recording> (100, 4);
+    ASSERT_EQ (group.size(), 100);
+    ASSERT_EQ (live, 100);
+    ASSERT_EQ (construction_threads.size(), 4);
+    for (size_t i=0; i<group.size(); ++i)
+    { ASSERT_EQ (group[i].value, 42); }
+  }
+  ASSERT_EQ (live, 0);
+  ObjectGroup<Counter> group;
+  throw_countdown = 50;
+  ASSERT_THROW (group.construct_parallel<Throwing> (100, 4), std::runtime_error);
+  ASSERT_EQ (live, 0);
+  ASSERT_FALSE (group.is_constructed());
+}
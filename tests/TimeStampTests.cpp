@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "n88util/TimeStamp.hpp"
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+
+// Create a test fixture class.
+class TimeStampTests : public ::testing::Test
+{};
+
+// --------------------------------------------------------------------
+// test implementations
+
+TEST_F (TimeStampTests, default_mode)
+{
+  n88::TimeStamp ts;
+  ASSERT_EQ (ts.GetMode(), n88::TimeStamp::CPU);
+  ASSERT_GE (ts.Elapsed(), 0.0);
+}
+
+// Wall time includes time spent sleeping; thread CPU time does not.
+TEST_F (TimeStampTests, wall_and_thread_cpu)
+{
+  n88::TimeStamp wall (n88::TimeStamp::WALL);
+  n88::TimeStamp thread_cpu (n88::TimeStamp::THREAD_CPU);
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  ASSERT_GE (wall.ElapsedNanoseconds(), 50000000);
+  ASSERT_LT (thread_cpu.Elapsed(), 0.04);
+  wall.Restart();
+  ASSERT_LT (wall.Elapsed(), 0.04);
+}
+
+TEST_F (TimeStampTests, print)
+{
+  n88::TimeStamp ts (n88::TimeStamp::WALL);
+  ASSERT_EQ (ts.Print(), "   0.00 ");
+  char text[64];
+  ASSERT_EQ (ts.Print (text, sizeof(text)), 8);
+  ASSERT_STREQ (text, "   0.00 ");
+  // Truncated to fit.
+  ASSERT_EQ (ts.Print (text, 4), 3);
+  ASSERT_STREQ (text, "   ");
+  std::ostringstream s;
+  s << ts;
+  ASSERT_EQ (s.str(), "   0.00 ");
+}
+
+TEST_F (TimeStampTests, set_format)
+{
+  n88::TimeStamp ts (n88::TimeStamp::WALL);
+  ts.SetFormat ("[%.1f]");
+  ASSERT_EQ (ts.Print(), "[0.0]");
+  char text[4];
+  ASSERT_EQ (ts.Print (text, sizeof(text)), 3);
+  ASSERT_STREQ (text, "[0.");
+}
@@ -0,0 +1,328 @@
+#include <gtest/gtest.h>
+
+#include "n88util/TrackingAllocator.hpp"
+#include "n88util/array.hpp"
+#include "n88util/exception.hpp"
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+using namespace n88;
+
+
+// Create a test fixture class.
+class TrackingAllocatorTests : public ::testing::Test
+{
+  protected:
+
+    void TearDown () override
+    {
+      TrackingAllocator::set_memory_limits (0, 0);
+      TrackingAllocator::set_memory_limit_callback (TrackingAllocator::memory_limit_callback());
+    }
+
+    static TrackingAllocatorTagStatistics GetTag (const std::string& tag)
+    {
+      const std::vector<TrackingAllocatorTagStatistics> statistics =
+          TrackingAllocator::get_tag_statistics();
+      for (size_t i=0; i<statistics.size(); ++i)
+      {
+        if (statistics[i].tag == tag)
+          { return statistics[i]; }
+      }
+      TrackingAllocatorTagStatistics none = {tag, 0, 0, 0, 0, 0};
+      return none;
+    }
+
+    static TrackingAllocatorSizeClass GetSizeClass (size_t size)
+    {
+      const std::vector<TrackingAllocatorSizeClass> histogram =
+          TrackingAllocator::get_size_histogram();
+      for (size_t i=0; i<histogram.size(); ++i)
+      {
+        if (histogram[i].min_size <= size && size <= histogram[i].max_size)
+          { return histogram[i]; }
+      }
+      TrackingAllocatorSizeClass none = {0, 0, 0, 0, 0};
+      return none;
+    }
+};
+
+namespace
+{
+  // Two different places that create arrays.
+  void make_first (n88::array<1,double>& a)
+  { a.construct (10); }
+
+  n88::array<1,double>* make_second ()
+  { return new n88::array<1,double> (20); }
+}
+
+// --------------------------------------------------------------------
+// test implementations
+
+TEST_F (TrackingAllocatorTests, this_thread)
+{
+  const size_t current = TrackingAllocator::get_current_allocated();
+  void* p = TrackingAllocator::allocate (1000);
+  ASSERT_TRUE (p != NULL);
+  ASSERT_EQ (TrackingAllocator::get_current_allocated(), current + 1000);
+  ASSERT_GE (TrackingAllocator::get_peak_allocated(), current + 1000);
+  TrackingAllocator::release (p, 1000);
+  ASSERT_EQ (TrackingAllocator::get_current_allocated(), current);
+}
+
+// Small changes are merged into the global totals on demand.
+TEST_F (TrackingAllocatorTests, global_small)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  const size_t count = TrackingAllocator::get_global_allocation_count();
+  void* p = TrackingAllocator::allocate (100);
+  TrackingAllocator::external_increase (50);
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current + 150);
+  ASSERT_EQ (TrackingAllocator::get_global_allocation_count(), count + 1);
+  ASSERT_GE (TrackingAllocator::get_global_peak_allocated(), current + 150);
+  TrackingAllocator::external_decrease (50);
+  TrackingAllocator::release (p, 100);
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current);
+}
+
+// Memory freed on a different thread than allocated it.
+TEST_F (TrackingAllocatorTests, cross_thread)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  const size_t count = TrackingAllocator::get_global_allocation_count();
+  void* p = NULL;
+  std::thread ([&p] () { p = TrackingAllocator::allocate (1000); }).join();
+  ASSERT_TRUE (p != NULL);
+  // The allocating thread merged its changes on exit.
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current + 1000);
+  ASSERT_EQ (TrackingAllocator::get_global_allocation_count(), count + 1);
+  std::thread ([p] () { TrackingAllocator::release (p, 1000); }).join();
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current);
+}
+
+TEST_F (TrackingAllocatorTests, global_peak)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  const size_t size = 4*TrackingAllocator::merge_threshold;
+  void* p = TrackingAllocator::allocate (size);
+  std::thread ([size] ()
+    {
+      void* q = TrackingAllocator::allocate (size);
+      TrackingAllocator::release (q, size);
+    }).join();
+  TrackingAllocator::release (p, size);
+  ASSERT_GE (TrackingAllocator::get_global_peak_allocated(), current + 2*size);
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current);
+}
+
+TEST_F (TrackingAllocatorTests, statistics_disabled)
+{
+  ASSERT_FALSE (TrackingAllocator::get_statistics_enabled());
+  const size_t allocations = GetSizeClass (3000).allocations;
+  void* p = TrackingAllocator::allocate (3000, "disabled");
+  TrackingAllocator::release (p, 3000);
+  ASSERT_EQ (GetSizeClass (3000).allocations, allocations);
+  ASSERT_EQ (GetTag ("disabled").allocations, 0);
+}
+
+TEST_F (TrackingAllocatorTests, statistics)
+{
+  TrackingAllocator::set_statistics_enabled (true);
+  const TrackingAllocatorSizeClass before = GetSizeClass (5000);
+  void* p = TrackingAllocator::allocate (5000, "tagged");
+  void* q;
+  void* r;
+  {
+    TrackingAllocator::scoped_tag tag ("scoped");
+    q = TrackingAllocator::allocate (4100);
+    {
+      TrackingAllocator::scoped_tag inner ("inner");
+      r = TrackingAllocator::allocate (100);
+    }
+    TrackingAllocator::release (r, 100);
+  }
+  TrackingAllocator::set_statistics_enabled (false);
+  // Allocated while enabled, so counted when freed.
+  TrackingAllocator::release (q, 4100);
+
+  const TrackingAllocatorSizeClass after = GetSizeClass (5000);
+  ASSERT_EQ (after.min_size, 4096);
+  ASSERT_EQ (after.max_size, 8191);
+  ASSERT_EQ (after.allocations, before.allocations + 2);
+  ASSERT_EQ (after.frees, before.frees + 1);
+  ASSERT_EQ (after.bytes, before.bytes + 9100);
+
+  const TrackingAllocatorTagStatistics tagged = GetTag ("tagged");
+  ASSERT_EQ (tagged.allocations, 1);
+  ASSERT_EQ (tagged.frees, 0);
+  ASSERT_EQ (tagged.current, 5000);
+  const TrackingAllocatorTagStatistics scoped = GetTag ("scoped");
+  ASSERT_EQ (scoped.allocations, 1);
+  ASSERT_EQ (scoped.frees, 1);
+  ASSERT_EQ (scoped.current, 0);
+  ASSERT_EQ (scoped.peak, 4100);
+  ASSERT_EQ (GetTag ("inner").bytes, 100);
+
+  std::ostringstream report;
+  TrackingAllocator::report_statistics (report);
+  ASSERT_NE (report.str().find ("4096-8191"), std::string::npos);
+  ASSERT_NE (report.str().find ("\nscoped "), std::string::npos);
+
+  TrackingAllocator::release (p, 5000);
+  ASSERT_EQ (GetTag ("tagged").current, 0);
+}
+
+// Untagged allocations are attributed to the call site.
+TEST_F (TrackingAllocatorTests, call_site)
+{
+  TrackingAllocator::set_statistics_enabled (true);
+  const size_t count = TrackingAllocator::get_tag_statistics().size();
+  void* p = TrackingAllocator::allocate (10);
+  TrackingAllocator::set_statistics_enabled (false);
+  const std::vector<TrackingAllocatorTagStatistics> statistics = TrackingAllocator::get_tag_statistics();
+  TrackingAllocator::release (p, 10);
+  ASSERT_EQ (statistics.size(), count + 1);
+  ASSERT_NE (statistics.back().tag, "(untagged)");
+  ASSERT_EQ (statistics.back().allocations, 1);
+}
+
+// Allocations from the same call site on different threads share a tag.
+TEST_F (TrackingAllocatorTests, call_site_threads)
+{
+  TrackingAllocator::set_statistics_enabled (true);
+  const size_t count = TrackingAllocator::get_tag_statistics().size();
+  const auto work = [] ()
+    {
+      for (int i=0; i<100; ++i)
+      {
+        void* p = TrackingAllocator::allocate (20);
+        TrackingAllocator::release (p, 20);
+      }
+    };
+  std::thread a (work);
+  std::thread b (work);
+  a.join();
+  b.join();
+  TrackingAllocator::set_statistics_enabled (false);
+  const std::vector<TrackingAllocatorTagStatistics> statistics = TrackingAllocator::get_tag_statistics();
+  ASSERT_EQ (statistics.size(), count + 1);
+  ASSERT_EQ (statistics.back().allocations, 200);
+  ASSERT_EQ (statistics.back().frees, 200);
+}
+
+// Arrays are attributed to the code that creates them, not to array.
+TEST_F (TrackingAllocatorTests, call_site_array)
+{
+  TrackingAllocator::set_statistics_enabled (true);
+  const size_t count = TrackingAllocator::get_tag_statistics().size();
+  n88::array<1,double> a;
+  make_first (a);
+  n88::array<1,double>* b = make_second ();
+  TrackingAllocator::set_statistics_enabled (false);
+  const std::vector<TrackingAllocatorTagStatistics> statistics = TrackingAllocator::get_tag_statistics();
+  delete b;
+  ASSERT_EQ (statistics.size(), count + 2);
+  ASSERT_EQ (statistics[count].allocations, 1);
+  ASSERT_EQ (statistics[count].bytes, 10*sizeof(double));
+  ASSERT_EQ (statistics[count+1].allocations, 1);
+  ASSERT_EQ (statistics[count+1].bytes, 20*sizeof(double));
+}
+
+TEST_F (TrackingAllocatorTests, aligned)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  for (size_t alignment=1; alignment<=8192; alignment*=2)
+  {
+    void* p = TrackingAllocator::allocate_aligned (1000, alignment);
+    ASSERT_TRUE (p != NULL);
+    ASSERT_EQ (size_t(p) % alignment, 0);
+    ASSERT_EQ (size_t(p) % alignof(std::max_align_t), 0);
+    memset (p, 0, 1000);
+    ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current + 1000);
+    TrackingAllocator::release (p, 1000);
+  }
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current);
+  struct alignas(256) block { char c[256]; };
+  n88::array<1,block> a;
+  a.construct (3);
+  ASSERT_EQ (size_t(a.data()) % 256, 0);
+}
+
+TEST_F (TrackingAllocatorTests, hard_limit)
+{
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom(), SIZE_MAX);
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  TrackingAllocator::set_memory_limits (0, current + 1000000);
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom(), 1000000);
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom (TrackingAllocator::SOFT_LIMIT), SIZE_MAX);
+  void* p = TrackingAllocator::allocate (600000);
+  ASSERT_TRUE (p != NULL);
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom(), 400000);
+  ASSERT_TRUE (TrackingAllocator::allocate (500000) == NULL);
+  n88::array<1,char> a;
+  ASSERT_THROW (a.construct (500000), n88::n88_exception);
+  ASSERT_EQ (TrackingAllocator::get_global_current_allocated(), current + 600000);
+  TrackingAllocator::release (p, 600000);
+  // Frees are merged immediately while limits are set.
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom(), 1000000);
+  a.construct (500000);
+}
+
+TEST_F (TrackingAllocatorTests, soft_limit)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  TrackingAllocator::set_memory_limits (current + 1000, 0);
+  // Without a callback, the soft limit is only advisory.
+  void* p = TrackingAllocator::allocate (2000);
+  ASSERT_TRUE (p != NULL);
+  ASSERT_EQ (TrackingAllocator::get_memory_headroom (TrackingAllocator::SOFT_LIMIT), 0);
+  TrackingAllocator::release (p, 2000);
+
+  int calls = 0;
+  bool accept = false;
+  TrackingAllocator::set_memory_limit_callback (
+    [&] (TrackingAllocator::memory_limit_t limit, size_t requested, size_t now)
+    {
+      EXPECT_EQ (limit, TrackingAllocator::SOFT_LIMIT);
+      EXPECT_EQ (requested, 2000);
+      EXPECT_EQ (now, current);
+      ++calls;
+      return accept;
+    });
+  ASSERT_TRUE (TrackingAllocator::allocate (2000) == NULL);
+  accept = true;
+  p = TrackingAllocator::allocate (2000);
+  ASSERT_TRUE (p != NULL);
+  ASSERT_EQ (calls, 2);
+  TrackingAllocator::release (p, 2000);
+  // Within the limit.
+  p = TrackingAllocator::allocate (500);
+  ASSERT_EQ (calls, 2);
+  TrackingAllocator::release (p, 500);
+}
+
+// The callback can free memory to make room.
+TEST_F (TrackingAllocatorTests, hard_limit_callback)
+{
+  const size_t current = TrackingAllocator::get_global_current_allocated();
+  TrackingAllocator::set_memory_limits (0, current + 10000);
+  void* cache = TrackingAllocator::allocate (8000);
+  TrackingAllocator::set_memory_limit_callback (
+    [&] (TrackingAllocator::memory_limit_t limit, size_t, size_t)
+    {
+      if (limit != TrackingAllocator::HARD_LIMIT || cache == NULL)
+        { return false; }
+      TrackingAllocator::release (cache, 8000);
+      cache = NULL;
+      return true;
+    });
+  void* p = TrackingAllocator::allocate (5000);
+  ASSERT_TRUE (p != NULL);
+  ASSERT_TRUE (cache == NULL);
+  // Nothing more to free.
+  ASSERT_TRUE (TrackingAllocator::allocate (6000) == NULL);
+  TrackingAllocator::release (p, 5000);
+}
@@ -1,5 +1,7 @@
 #include "n88util/array.hpp"
 #include <gtest/gtest.h>
+#include <numeric>
+#include <algorithm>
 
 using namespace n88;
 
@@ -110,3 +112,37 @@ TEST_F (arrayTests, FlatIndexing3)
   ASSERT_EQ(A[6], 3.0);
 }
 
+TEST_F (arrayTests, Iterators)
+{
+  array<2,double> A(2,3);
+  ASSERT_EQ(A.begin(), A.data());
+  ASSERT_EQ(A.end() - A.begin(), 6);
+  std::iota(A.begin(), A.end(), 1.0);
+  ASSERT_EQ(A(1,2), 6.0);
+  double total = 0.0;
+  for (double x : A)
+  { total += x; }
+  ASSERT_EQ(total, 21.0);
+  array<2,double> B(2,3);
+  std::transform(A.begin(), A.end(), B.begin(), [](double x) { return 2*x; });
+  ASSERT_EQ(B(0,1), 4.0);
+  ASSERT_EQ(std::reduce(B.begin(), B.end()), 42.0);
+  ASSERT_FALSE(A.empty());
+  ASSERT_TRUE((array<1,double>().empty()));
+}
+
+#if __cplusplus >= 202002L
+TEST_F (arrayTests, Ranges)
+{
+  static_assert(std::ranges::contiguous_range<array<2,double> >);
+  static_assert(std::ranges::sized_range<array<2,double> >);
+  array<2,double> A(2,3);
+  std::ranges::fill(A, 3.0);
+  std::span<double> s = A.as_span();
+  ASSERT_EQ(s.size(), 6);
+  ASSERT_EQ(s[5], 3.0);
+  std::span<double> s2(A);
+  ASSERT_EQ(s2.data(), A.data());
+}
+#endif
+
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
 #include "n88util/binhex.hpp"
+#include <sstream>
+#include <algorithm>
 
 
 // Create a test fixture class.
@@ -140,3 +142,189 @@ TEST_F (binhexTests, test_hextobin_cpp_string)
   free(buffer_string);
   free(buffer_char);
 }
+
+// Test round trip of all byte values over lengths that exercise both the
+// vectorized and the scalar code paths.
+TEST_F (binhexTests, round_trip_long_buffers)
+{
+  const char valid_hex_chars[] = "0123456789ABCDEF";
+  unsigned char buffer[1000];
+  for (int i=0; i<1000; i++)
+  {
+    buffer[i] = (unsigned char)(i*37 + i/256);
+  }
+  for (long len=0; len<=1000; len += (len < 130 ? 1 : 97))
+  {
+    char* hex = NULL;
+    ASSERT_EQ(n88util::bintohex(buffer, len, &hex), 1);
+    ASSERT_EQ(strlen(hex), 2*len);
+    for (long i=0; i<len; i++)
+    {
+      ASSERT_EQ(hex[2*i], valid_hex_chars[buffer[i] >> 4]);
+      ASSERT_EQ(hex[2*i+1], valid_hex_chars[buffer[i] & 0x0F]);
+    }
+    unsigned char* returned_buffer = NULL;
+    long returned_len;
+    ASSERT_EQ(n88util::hextobin(hex, &returned_buffer, &returned_len), 1);
+    ASSERT_EQ(returned_len, len);
+    ASSERT_EQ(memcmp(buffer, returned_buffer, len), 0);
+    free(returned_buffer);
+    free(hex);
+  }
+}
+
+// Test that an invalid character anywhere in a long string is detected.
+TEST_F (binhexTests, invalid_hex_long)
+{
+  std::string hex(300, 'A');
+  const char bad_chars[] = "aGg/:@\x80 ";
+  for (size_t pos=0; pos<hex.size(); pos++)
+  {
+    std::string bad_hex = hex;
+    bad_hex[pos] = bad_chars[pos % (sizeof(bad_chars)-1)];
+    unsigned char* buffer = NULL;
+    long len;
+    ASSERT_EQ(n88util::hextobin(bad_hex, &buffer, &len), 0);
+    ASSERT_EQ(buffer, (unsigned char*)NULL);
+    ASSERT_EQ(len, 0);
+  }
+}
+
+// Test encoding to and decoding from caller-provided buffers.
+TEST_F (binhexTests, caller_buffers)
+{
+  const unsigned char buffer[] = {0x30, 0x81, 0xFA, 0x02, 0x01};
+  char hex[11];
+  memset(hex, 'x', sizeof(hex));
+  ASSERT_EQ(n88util::bintohex(buffer, 5, hex, 9), 0);
+  ASSERT_EQ(n88util::bintohex(buffer, 5, hex, 10), 1);
+  ASSERT_EQ(std::string(hex, 11), "3081FA0201x");
+  unsigned char returned_buffer[5];
+  ASSERT_EQ(n88util::hextobin(std::string_view(hex, 10), returned_buffer, 4), 0);
+  ASSERT_EQ(n88util::hextobin(std::string_view(hex, 10), returned_buffer, 5), 1);
+  ASSERT_EQ(memcmp(buffer, returned_buffer, 5), 0);
+  ASSERT_EQ(n88util::hextobin(std::string_view("30X1"), returned_buffer, 5), 0);
+}
+
+// Test appending to existing strings and vectors.
+TEST_F (binhexTests, append)
+{
+  const unsigned char buffer[] = {0x30, 0x81, 0xFA};
+  std::string hex = "prefix:";
+  ASSERT_EQ(n88util::bintohex_append(buffer, 3, hex), 1);
+  ASSERT_EQ(hex, "prefix:3081FA");
+  std::vector<char> hex_vector(1, '#');
+  ASSERT_EQ(n88util::bintohex_append(buffer, 3, hex_vector), 1);
+  ASSERT_EQ(std::string(hex_vector.begin(), hex_vector.end()), "#3081FA");
+  std::vector<unsigned char> bin(1, 0x55);
+  ASSERT_EQ(n88util::hextobin_append(std::string_view(hex).substr(7), bin), 1);
+  ASSERT_EQ(bin.size(), 4);
+  ASSERT_EQ(memcmp(bin.data() + 1, buffer, 3), 0);
+  ASSERT_EQ(n88util::hextobin_append("30G1", bin), 0);
+  ASSERT_EQ(bin.size(), 4);
+}
+
+// Test that decoding in chunks of every size gives the same result as
+// decoding all at once.
+TEST_F (binhexTests, hex_decoder_chunks)
+{
+  const char hex[] = "3081FA020100024130DEADBEEF0123456789ABCDEF3081FA0201000241";
+  const size_t hex_len = strlen(hex);
+  std::vector<unsigned char> expected;
+  ASSERT_EQ(n88util::hextobin_append(hex, expected), 1);
+  for (size_t chunk=1; chunk<=hex_len; chunk++)
+  {
+    n88util::hex_decoder decoder;
+    std::vector<unsigned char> result;
+    unsigned char buf[64];
+    for (size_t i=0; i<hex_len; i+=chunk)
+    {
+      size_t n;
+      ASSERT_EQ(decoder.update(hex + i, std::min(chunk, hex_len - i), buf, &n), 1);
+      result.insert(result.end(), buf, buf + n);
+    }
+    ASSERT_FALSE(decoder.pending());
+    ASSERT_EQ(result, expected);
+  }
+  n88util::hex_decoder decoder;
+  unsigned char buf[4];
+  size_t n;
+  ASSERT_EQ(decoder.update("3", 1, buf, &n), 1);
+  ASSERT_TRUE(decoder.pending());
+  ASSERT_EQ(decoder.update("G", 1, buf, &n), 0);
+}
+
+// Test round trip through streams.
+TEST_F (binhexTests, streams)
+{
+  std::string data;
+  for (int i=0; i<200000; i++)
+  {
+    data += (char)(i*31 + i/7);
+  }
+  std::istringstream bin_in(data);
+  std::ostringstream hex_out;
+  ASSERT_EQ(n88util::bintohex(bin_in, hex_out), 1);
+  std::string hex;
+  ASSERT_EQ(n88util::bintohex((const unsigned char*)data.data(), (long)data.size(), hex), 1);
+  ASSERT_EQ(hex_out.str(), hex);
+  std::istringstream hex_in(hex);
+  std::ostringstream bin_out;
+  ASSERT_EQ(n88util::hextobin(hex_in, bin_out), 1);
+  ASSERT_EQ(bin_out.str(), data);
+  std::istringstream bad_in("3081FA0T");
+  std::ostringstream bad_out;
+  ASSERT_EQ(n88util::hextobin(bad_in, bad_out), 0);
+}
+
+// Test decoding of lower and mixed case.
+TEST_F (binhexTests, any_case)
+{
+  const unsigned char expected[] = {0x30, 0x81, 0xFA, 0xDE, 0xAD, 0xBE, 0xEF};
+  unsigned char buffer[7];
+  size_t position;
+  ASSERT_EQ(n88util::hextobin("3081faDeAdbEEF", buffer, 7, n88util::HEX_UPPER_CASE, &position), 0);
+  ASSERT_EQ(position, 4);
+  ASSERT_EQ(n88util::hextobin("3081faDeAdbEEF", buffer, 7, n88util::HEX_ANY_CASE, &position), 1);
+  ASSERT_EQ(position, 14);
+  ASSERT_EQ(memcmp(buffer, expected, 7), 0);
+  n88util::hex_decoder decoder(n88util::HEX_ANY_CASE);
+  size_t n;
+  ASSERT_EQ(decoder.update("3081faDeAdbEEF", 14, buffer, &n), 1);
+  ASSERT_EQ(n, 7);
+  ASSERT_EQ(memcmp(buffer, expected, 7), 0);
+}
+
+// Test that the position of the first invalid character is reported
+// correctly in long strings, for both case modes.
+TEST_F (binhexTests, invalid_position)
+{
+  std::string hex;
+  for (int i=0; i<150; i++)
+  {
+    hex += "aF";
+  }
+  std::vector<unsigned char> buffer;
+  size_t position;
+  ASSERT_EQ(n88util::hextobin_append(hex, buffer, n88util::HEX_ANY_CASE, &position), 1);
+  ASSERT_EQ(position, hex.size());
+  ASSERT_EQ(buffer.size(), 150);
+  ASSERT_EQ(buffer[149], 0xAF);
+  const char bad_chars[] = "gG/:@`\x80 ";
+  for (size_t pos=0; pos<hex.size(); pos++)
+  {
+    std::string bad_hex = hex;
+    bad_hex[pos] = bad_chars[pos % (sizeof(bad_chars)-1)];
+    buffer.clear();
+    ASSERT_EQ(n88util::hextobin_append(bad_hex, buffer, n88util::HEX_ANY_CASE, &position), 0);
+    ASSERT_EQ(position, pos);
+    ASSERT_EQ(buffer.size(), 0);
+    ASSERT_EQ(n88util::hextobin_append(bad_hex, buffer, n88util::HEX_UPPER_CASE, &position), 0);
+    ASSERT_EQ(position, 0);
+  }
+  // A buffer that is too small is reported with npos.
+  unsigned char small[10];
+  position = 0;
+  ASSERT_EQ(n88util::hextobin(hex, small, sizeof(small), n88util::HEX_ANY_CASE, &position), 0);
+  ASSERT_EQ(position, std::string_view::npos);
+}
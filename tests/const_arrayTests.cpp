@@ -1,6 +1,8 @@
 #include "n88util/const_array.hpp"
 #include "n88util/array.hpp"
 #include <gtest/gtest.h>
+#include <numeric>
+#include <algorithm>
 
 using namespace n88;
 
@@ -65,3 +67,30 @@ TEST_F (const_array_Tests, FlatIndexing3)
   ASSERT_EQ(C[6], 3.0);
 }
 
+TEST_F (const_array_Tests, Iterators)
+{
+  double a[] = {1.0,2.0,3.0,4.0,5.0,6.0};
+  const_array<2,double> C(a,2,3);
+  ASSERT_EQ(C.begin(), a);
+  ASSERT_EQ(C.end() - C.begin(), 6);
+  ASSERT_EQ(std::accumulate(C.begin(), C.end(), 0.0), 21.0);
+  ASSERT_EQ(*std::max_element(C.begin(), C.end()), 6.0);
+  double total = 0.0;
+  for (double x : C)
+  { total += x; }
+  ASSERT_EQ(total, 21.0);
+}
+
+#if __cplusplus >= 202002L
+TEST_F (const_array_Tests, Ranges)
+{
+  static_assert(std::ranges::contiguous_range<const_array<2,double> >);
+  static_assert(std::ranges::borrowed_range<const_array<2,double> >);
+  double a[] = {1.0,2.0,3.0,4.0,5.0,6.0};
+  const_array<2,double> C(a,2,3);
+  std::span<const double> s = C.as_span();
+  ASSERT_EQ(s.size(), 6);
+  ASSERT_EQ(std::ranges::max(C), 6.0);
+  ASSERT_EQ(*std::ranges::find(const_array<2,double>(a,2,3), 4.0), 4.0);
+}
+#endif
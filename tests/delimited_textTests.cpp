@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include "n88util/delimited_text.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace n88;
+
+// Create a test fixture class.
+class delimited_textTests : public ::testing::Test
+{};
+
+// --------------------------------------------------------------------
+// test implementations
+
+// Basic test of parse_delimited
+TEST_F (delimited_textTests, parse)
+{
+  std::string text = "1 2.5 3\n\n  4,-5e2\t+6\r\n7 8 9";
+  array<2,double> data;
+  n88util::parse_delimited(text, data);
+  ASSERT_EQ(data.dims(), (tuplet<2,size_t>(3,3)));
+  ASSERT_EQ(data(0,1), 2.5);
+  ASSERT_EQ(data(1,1), -500.0);
+  ASSERT_EQ(data(1,2), 6.0);
+  ASSERT_EQ(data(2,2), 9.0);
+}
+
+// Test parsing integers with specified separators
+TEST_F (delimited_textTests, parse_integers)
+{
+  array<2,int,int> data;
+  n88util::parse_delimited("1;2\n3;-4\n", data, ";");
+  ASSERT_EQ(data.dims(), (tuplet<2,int>(2,2)));
+  ASSERT_EQ(data(1,1), -4);
+}
+
+// Test that invalid input throws exceptions
+TEST_F (delimited_textTests, invalid)
+{
+  array<2,double> data;
+  ASSERT_THROW(n88util::parse_delimited("1 2\n3 x\n", data), n88::n88_exception);
+  array<2,double> data2;
+  ASSERT_THROW(n88util::parse_delimited("1 2\n3 4 5\n", data2), n88::n88_exception);
+  array<2,int> data3;
+  ASSERT_THROW(n88util::parse_delimited("1 2.5\n", data3), n88::n88_exception);
+}
+
+// Test that parallel parsing of a large input gives the same result as
+// serial parsing.
+TEST_F (delimited_textTests, parallel)
+{
+  std::ostringstream text;
+  const size_t rows = 100000;
+  for (size_t i=0; i<rows; i++)
+  {
+    text << i << ", " << 0.25*i << ", " << -double(i) << "\n";
+    if (i % 1000 == 0)
+    {
+      text << "\n";
+    }
+  }
+  array<2,double> serial;
+  n88util::parse_delimited(text.str(), serial, NULL, 1);
+  array<2,double> parallel;
+  n88util::parse_delimited(text.str(), parallel, NULL, 4);
+  ASSERT_EQ(parallel.dims(), (tuplet<2,size_t>(rows,3)));
+  ASSERT_EQ(memcmp(serial.data(), parallel.data(), serial.size()*sizeof(double)), 0);
+  ASSERT_EQ(parallel(rows-1,0), double(rows-1));
+  ASSERT_EQ(parallel(1000,2), -1000.0);
+}
+
+// Test reading from a file
+TEST_F (delimited_textTests, load)
+{
+  const char filename[] = "delimited_textTests_load.txt";
+  {
+    std::ofstream f(filename);
+    f << "1 2\n3 4\n";
+  }
+  array<2,float> data;
+  n88util::load_delimited(filename, data);
+  std::remove(filename);
+  ASSERT_EQ(data.dims(), (tuplet<2,size_t>(2,2)));
+  ASSERT_EQ(data(1,0), 3.0f);
+  array<2,float> missing;
+  ASSERT_THROW(n88util::load_delimited("no_such_file.txt", missing), n88::n88_exception);
+}
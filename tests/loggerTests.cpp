@@ -0,0 +1,437 @@
+#include <gtest/gtest.h>
+
+#include "n88util/logger.hpp"
+#include "n88util/exception.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace n88::io;
+
+// Create a test fixture class.
+class loggerTests : public ::testing::Test
+{};
+
+// --------------------------------------------------------------------
+// test implementations
+
+// Basic test of synchronous logging
+TEST_F (loggerTests, synchronous)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log << important_level << "one " << 2 << "\n";
+  log << console_only << "console ";
+  log << "three\n";
+  ASSERT_EQ(console.str(), "one 2\nconsole three\n");
+  ASSERT_EQ(log.GetLog(), "one 2\nthree\n");
+  log.SetConsoleLevel(IMPORTANT);
+  log << informative_level << "quiet\n";
+  ASSERT_EQ(console.str(), "one 2\nconsole three\n");
+  ASSERT_EQ(log.GetLog(), "one 2\nthree\nquiet\n");
+}
+
+// Test that asynchronous logging produces the same output
+TEST_F (loggerTests, asynchronous)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log.SetAsynchronous(true);
+  ASSERT_TRUE(log.GetAsynchronous());
+  log << important_level << "one " << 2 << "\n";
+  log << console_only << "console ";
+  log << "three\n";
+  log.Flush();
+  ASSERT_EQ(console.str(), "one 2\nconsole three\n");
+  ASSERT_EQ(log.GetLog(), "one 2\nthree\n");
+  // Output longer than a record is split and reassembled.
+  const std::string big(100000, 'x');
+  log << big;
+  log.SetAsynchronous(false);
+  ASSERT_EQ(log.GetLog(), "one 2\nthree\n" + big);
+}
+
+// Test that a message too big to be queued is written after the
+// messages queued before it, while another thread keeps the
+// background thread busy
+TEST_F (loggerTests, asynchronous_large_order)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log.SetAsynchronous(true);
+  log << "start\n";
+  std::atomic<bool> done(false);
+  std::thread other([&log, &done]()
+  {
+    while (!done)
+    {
+      log << "other\n";
+    }
+  });
+  const std::string big(100000, 'x');
+  std::string expected = "start\n";
+  for (int i=0; i<200; i++)
+  {
+    const std::string before = "before " + std::to_string(i) + "\n";
+    const std::string after = "after " + std::to_string(i) + "\n";
+    log << before;
+    log << big;
+    log << after;
+    expected += before + big + after;
+  }
+  done = true;
+  other.join();
+  log.Flush();
+  // Remove the other thread's messages.
+  const std::string all = console.str();
+  std::string output;
+  size_t begin = 0;
+  size_t p;
+  while ((p = all.find("other\n", begin)) != std::string::npos)
+  {
+    output.append(all, begin, p - begin);
+    begin = p + 6;
+  }
+  output.append(all, begin, std::string::npos);
+  ASSERT_TRUE(output == expected);
+}
+
+// Test asynchronous logging from several threads
+TEST_F (loggerTests, asynchronous_threads)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log.SetAsynchronous(true);
+  const int nthreads = 4;
+  const int count = 20000;
+  std::vector<std::thread> threads;
+  for (int t=0; t<nthreads; t++)
+  {
+    threads.emplace_back([&log, t]()
+    {
+      for (int i=0; i<count; i++)
+      {
+        log << std::string(1, char('a' + t));
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  log.Flush();
+  const std::string output = console.str();
+  ASSERT_EQ(output.size(), size_t(nthreads*count));
+  for (int t=0; t<nthreads; t++)
+  {
+    ASSERT_EQ(std::count(output.begin(), output.end(), char('a' + t)), count);
+  }
+}
+
+// Test building messages with log_message
+TEST_F (loggerTests, message)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log.SetConsoleLevel(IMPORTANT);
+  log.Message(IMPORTANT) << "a " << 1 << "\n";
+  log.Message(INFORMATIVE) << "b " << 2 << "\n";
+  log.Message(ERROR) << console_only << "c " << 3 << "\n";
+  ASSERT_EQ(console.str(), "a 1\nc 3\n");
+  ASSERT_EQ(log.GetLog(), "a 1\nb 2\n");
+  {
+    // Messages may be nested, and are committed when destroyed.
+    log_message outer(log, IMPORTANT);
+    outer << "outer ";
+    log.Message(IMPORTANT) << "inner\n";
+    outer << "done\n";
+  }
+  ASSERT_EQ(console.str(), "a 1\nc 3\ninner\nouter done\n");
+}
+
+// Test that messages from several threads are not interleaved
+TEST_F (loggerTests, message_threads)
+{
+  for (int async=0; async<2; async++)
+  {
+    std::ostringstream console;
+    logger log;
+    log.SetConsoleStream(console);
+    log.SetAsynchronous(async == 1);
+    const int nthreads = 4;
+    const int count = 2000;
+    std::vector<std::thread> threads;
+    for (int t=0; t<nthreads; t++)
+    {
+      threads.emplace_back([&log, t]()
+      {
+        for (int i=0; i<count; i++)
+        {
+          log.Message(IMPORTANT) << "thread " << t << " message " << i << "\n";
+        }
+      });
+    }
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+    log.Flush();
+    ASSERT_EQ(log.GetLog(), console.str());
+    std::istringstream lines(console.str());
+    std::string line;
+    std::vector<int> next(nthreads, 0);
+    while (std::getline(lines, line))
+    {
+      int t, i;
+      ASSERT_EQ(sscanf(line.c_str(), "thread %d message %d", &t, &i), 2);
+      // Messages from any one thread are in order.
+      ASSERT_EQ(i, next[t]);
+      next[t]++;
+    }
+    ASSERT_EQ(next, std::vector<int>(nthreads, count));
+  }
+}
+
+// Test that filtered messages are not formatted
+TEST_F (loggerTests, level_filtering)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  ASSERT_FALSE(log.IsEnabled(VERBOSE));
+  ASSERT_TRUE(log.IsEnabled(INFORMATIVE));
+  int evaluated = 0;
+  const auto count = [&evaluated]() { return ++evaluated; };
+  N88_LOG(log, VERBOSE) << "hidden " << count() << "\n";
+  log.Log(VERBOSE, [&](log_message& m) { m << "hidden " << count() << "\n"; });
+  log << verbose_level << "hidden\n";
+  ASSERT_EQ(evaluated, 0);
+  N88_LOG(log, INFORMATIVE) << "shown " << count() << "\n";
+  log.Log(IMPORTANT, [&](log_message& m) { m << "shown " << count() << "\n"; });
+  ASSERT_EQ(evaluated, 2);
+  ASSERT_EQ(console.str(), "shown 1\nshown 2\n");
+  ASSERT_EQ(log.GetLog(), "shown 1\nshown 2\n");
+  // Separate thresholds for the console and the log.
+  log.SetConsoleLevel(VERBOSE);
+  log.SetHistoryLevel(IMPORTANT);
+  N88_LOG(log, VERBOSE) << "console\n";
+  log << important_level << "both\n";
+  ASSERT_EQ(console.str(), "shown 1\nshown 2\nconsole\nboth\n");
+  ASSERT_EQ(log.GetLog(), "shown 1\nshown 2\nboth\n");
+}
+
+// Test limits on log_history
+TEST_F (loggerTests, history_limits)
+{
+  log_history history;
+  history.SetLimits(20, 3);
+  history.Append("one\n", 4);
+  history.Append("two\n", 4);
+  history.Append("three\n", 6);
+  ASSERT_EQ(history.Get(), "one\ntwo\nthree\n");
+  history.Append("four\n", 5);
+  ASSERT_EQ(history.Get(), "two\nthree\nfour\n");
+  // Whole messages are discarded to keep within the byte limit.
+  history.Append("fivefive\n", 9);
+  ASSERT_EQ(history.Get(), "three\nfour\nfivefive\n");
+  ASSERT_EQ(history.Begin(), uint64_t(8));
+  ASSERT_EQ(history.End(), uint64_t(28));
+  // Only the end of a message longer than the limit is kept.
+  history.Append("abcdefghijklmnopqrstuvwxyz\n", 27);
+  ASSERT_EQ(history.Get(), "hijklmnopqrstuvwxyz\n");
+  history.SetLimits(5, 0);
+  ASSERT_EQ(history.Get(), "");
+  history.Append("six\n", 4);
+  ASSERT_EQ(history.Get(), "six\n");
+}
+
+// Test reading the log incrementally
+TEST_F (loggerTests, read_since)
+{
+  std::ostringstream console;
+  logger log;
+  log.SetConsoleStream(console);
+  log.SetHistoryLimits(12);
+  std::string text;
+  uint64_t cursor = log.ReadLog(0, text);
+  ASSERT_EQ(cursor, uint64_t(0));
+  log.Message(IMPORTANT) << "one\n";
+  log.Message(IMPORTANT) << "two\n";
+  cursor = log.ReadLog(cursor, text);
+  ASSERT_EQ(text, "one\ntwo\n");
+  log.Message(IMPORTANT) << "three\n";
+  text.clear();
+  cursor = log.ReadLog(cursor, text);
+  ASSERT_EQ(text, "three\n");
+  ASSERT_EQ(cursor, uint64_t(14));
+  text.clear();
+  cursor = log.ReadLog(cursor, text);
+  ASSERT_EQ(text, "");
+  // If the reader falls behind, it gets what is left.
+  log.Message(IMPORTANT) << "four\n";
+  log.Message(IMPORTANT) << "five\n";
+  log.Message(IMPORTANT) << "six\n";
+  text.clear();
+  cursor = log.ReadLog(cursor, text);
+  ASSERT_EQ(text, "five\nsix\n");
+  ASSERT_EQ(log.GetLog(), "five\nsix\n");
+}
+
+// Test spilling the log to rotating files
+TEST_F (loggerTests, history_file)
+{
+  const std::string filename = "loggerTests_history.log";
+  {
+    log_history history;
+    history.SetLimits(0, 2);
+    history.SetSpillFile(filename, 10, 2);
+    for (int i=0; i<8; i++)
+    {
+      const std::string message = "message " + std::to_string(i) + "\n";
+      history.Append(message.data(), message.size());
+    }
+    ASSERT_EQ(history.Get(), "message 6\nmessage 7\n");
+  }
+  // Each file holds one message; the oldest have been deleted.
+  const auto read = [](const std::string& name)
+  {
+    std::ifstream f(name.c_str());
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+  };
+  ASSERT_EQ(read(filename), "message 7\n");
+  ASSERT_EQ(read(filename + ".1"), "message 6\n");
+  ASSERT_EQ(read(filename + ".2"), "message 5\n");
+  ASSERT_FALSE(std::ifstream((filename + ".3").c_str()).good());
+  std::remove(filename.c_str());
+  std::remove((filename + ".1").c_str());
+  std::remove((filename + ".2").c_str());
+}
+
+// Test writing and decoding a binary log
+TEST_F (loggerTests, binary_log)
+{
+  for (int async=0; async<2; async++)
+  {
+    std::stringstream binary;
+    std::ostringstream console;
+    logger log;
+    log.SetConsoleStream(console);
+    log.SetAsynchronous(async == 1);
+    ASSERT_FALSE(log.IsBinaryEnabled(IMPORTANT));
+    log.SetBinaryStream(&binary);
+    ASSERT_TRUE(log.IsBinaryEnabled(IMPORTANT));
+    ASSERT_FALSE(log.IsBinaryEnabled(VERBOSE));
+    for (int i=0; i<3; i++)
+    {
+      N88_LOG_BINARY(log, IMPORTANT, "Iteration {} residual {}", i, 0.5*i);
+    }
+    N88_LOG_BINARY(log, IMPORTANT, "Types {} {} {} {} {}",
+                   true, 'x', (unsigned long long)1 << 40, -2.5f, std::string("text"));
+    N88_LOG_BINARY(log, IMPORTANT, "No arguments\n");
+    N88_LOG_BINARY(log, VERBOSE, "Filtered {}", 1);
+    log.Flush();
+    // Binary events do not go to the console or the text log.
+    ASSERT_EQ(console.str(), "");
+    ASSERT_EQ(log.GetLog(), "");
+    std::ostringstream text;
+    ASSERT_EQ(n88::io::decode_binary_log(binary, text), size_t(5));
+    // Strip the times and levels.
+    std::istringstream lines(text.str());
+    std::string line;
+    std::vector<std::string> messages;
+    while (std::getline(lines, line))
+    {
+      ASSERT_EQ(line.substr(13, 12), "IMPORTANT   ");
+      messages.push_back(line.substr(25));
+    }
+    ASSERT_EQ(messages.size(), size_t(5));
+    ASSERT_EQ(messages[0], "Iteration 0 residual 0");
+    ASSERT_EQ(messages[2], "Iteration 2 residual 1");
+    ASSERT_EQ(messages[3], "Types true x 1099511627776 -2.5 text");
+    ASSERT_EQ(messages[4], "No arguments");
+  }
+}
+
+// Test that invalid binary logs are rejected
+TEST_F (loggerTests, binary_log_invalid)
+{
+  std::ostringstream text;
+  std::istringstream empty("");
+  ASSERT_THROW(n88::io::decode_binary_log(empty, text), n88::n88_exception);
+  std::stringstream binary;
+  {
+    logger log;
+    log.SetBinaryStream(&binary);
+    N88_LOG_BINARY(log, ERROR, "Value {}", 1.0);
+  }
+  const std::string data = binary.str();
+  std::istringstream truncated(data.substr(0, data.size() - 30));
+  ASSERT_THROW(n88::io::decode_binary_log(truncated, text), n88::n88_exception);
+  std::istringstream complete(data);
+  ASSERT_EQ(n88::io::decode_binary_log(complete, text), size_t(1));
+}
+
+// Test decoding times and levels from a hand-written binary log
+TEST_F (loggerTests, binary_log_clocks)
+{
+  std::string data("N88BLOG1");
+  auto append = [&data](auto x) { data.append((const char*)&x, sizeof(x)); };
+  append(uint32_t(0x01020304));
+  // Format 1: "Event {}" with one int32_t argument.
+  append(uint8_t(BINARY_LOG_DEFINE));
+  append(uint32_t(1));
+  append(uint32_t(8));
+  data += "Event {}";
+  append(uint32_t(1));
+  data += "i";
+  auto event = [&](uint64_t timestamp, uint8_t level, int32_t value)
+  {
+    append(uint8_t(BINARY_LOG_EVENT));
+    append(uint32_t(1));
+    append(timestamp);
+    append(level);
+    append(value);
+  };
+  auto clock = [&](uint64_t timestamp, int64_t ns)
+  {
+    append(uint8_t(BINARY_LOG_CLOCK));
+    append(timestamp);
+    append(ns);
+  };
+  // Two ticks per ns for the first second, then one tick per ns.
+  clock(1000, 5000000000);
+  event(1000 + 1000000000, ERROR, 1);
+  const std::string one_clock = data;
+  clock(1000 + 2000000000, 6000000000);
+  event(1000 + 3000000000, VERBOSE, 2);
+  clock(1000 + 4000000000, 8000000000);
+  event(1000 + 5000000000, INFORMATIVE, 3);
+  {
+    std::istringstream in(data);
+    std::ostringstream text;
+    ASSERT_EQ(n88::io::decode_binary_log(in, text), size_t(3));
+    ASSERT_EQ(text.str(),
+              "    0.500000 ERROR       Event 1\n"
+              "    2.000000 VERBOSE     Event 2\n"
+              "    4.000000 INFORMATIVE Event 3\n");
+  }
+  // With one clock record, the tick rate is unknown.
+  {
+    std::istringstream in(one_clock);
+    std::ostringstream text;
+    ASSERT_EQ(n88::io::decode_binary_log(in, text), size_t(1));
+    ASSERT_EQ(text.str(), "    0.000000 ERROR       Event 1\n");
+  }
+}
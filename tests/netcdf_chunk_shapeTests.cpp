@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "n88util/netcdf_chunk_shape.hpp"
+
+using namespace n88util;
+using n88::tuplet;
+
+// Create a test fixture class.
+class netcdf_chunk_shapeTests : public ::testing::Test
+{};
+
+// --------------------------------------------------------------------
+// test implementations
+
+TEST_F (netcdf_chunk_shapeTests, slice)
+{
+  tuplet<3,size_t> dims (1000,1000,1000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, SLICE_ACCESS)), (tuplet<3,size_t>(1,1000,1000)));
+  // A slice that does not fit is cut along dimension 1.
+  dims = tuplet<3,size_t> (10,2000,2000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, SLICE_ACCESS)), (tuplet<3,size_t>(1,524,2000)));
+}
+
+TEST_F (netcdf_chunk_shapeTests, block)
+{
+  tuplet<3,size_t> dims (1000,1000,1000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, BLOCK_ACCESS)), (tuplet<3,size_t>(101,101,101)));
+  // A short dimension donates its share to the others.
+  dims = tuplet<3,size_t> (2,5000,5000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, BLOCK_ACCESS)), (tuplet<3,size_t>(2,724,724)));
+}
+
+TEST_F (netcdf_chunk_shapeTests, whole)
+{
+  tuplet<3,size_t> dims (1000,1000,1000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, WHOLE_ACCESS)), (tuplet<3,size_t>(1,1000,1000)));
+  dims = tuplet<3,size_t> (1000,100,100);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, WHOLE_ACCESS)), (tuplet<3,size_t>(104,100,100)));
+}
+
+// Test that a variable smaller than the target chunk is a single chunk
+// (one slice thick for SLICE_ACCESS)
+TEST_F (netcdf_chunk_shapeTests, small)
+{
+  tuplet<3,size_t> dims (10,20,30);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, SLICE_ACCESS)), (tuplet<3,size_t>(1,20,30)));
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, BLOCK_ACCESS)), dims);
+  ASSERT_EQ ((nc_chunk_shape (dims, 4, WHOLE_ACCESS)), dims);
+}
+
+// Test that a smaller chunk_bytes gives smaller chunks
+TEST_F (netcdf_chunk_shapeTests, chunk_bytes)
+{
+  tuplet<3,size_t> dims (1000,1000,1000);
+  ASSERT_EQ ((nc_chunk_shape (dims, 8, BLOCK_ACCESS, 8*64*64*64)), (tuplet<3,size_t>(64,64,64)));
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "n88util/netcdf_slab_reader.hpp"
+#include "n88util/exception.hpp"
+#include <netcdf.h>
+#include <cstdio>
+#include <vector>
+
+using namespace n88util;
+
+// Create a test fixture class.
+class netcdf_slab_readerTests : public ::testing::Test
+{
+  protected:
+
+    // Writes a 5x3x4 int variable in which each entry is its flat index.
+    void SetUp () override
+    {
+      ASSERT_EQ (nc_create (filename, NC_NETCDF4 | NC_CLOBBER, &ncid), NC_NOERR);
+      int dimids[3];
+      ASSERT_EQ (nc_def_dim (ncid, "z", 5, &dimids[0]), NC_NOERR);
+      ASSERT_EQ (nc_def_dim (ncid, "y", 3, &dimids[1]), NC_NOERR);
+      ASSERT_EQ (nc_def_dim (ncid, "x", 4, &dimids[2]), NC_NOERR);
+      ASSERT_EQ (nc_def_var (ncid, "values", NC_INT, 3, dimids, &varid), NC_NOERR);
+      ASSERT_EQ (nc_enddef (ncid), NC_NOERR);
+      std::vector<int> values (5*3*4);
+      for (size_t i=0; i<values.size(); ++i)
+      { values[i] = int(i); }
+      ASSERT_EQ (nc_put_var_int (ncid, varid, values.data()), NC_NOERR);
+    }
+
+    void TearDown () override
+    {
+      nc_close (ncid);
+      std::remove (filename);
+    }
+
+    const char* filename = "netcdf_slab_readerTests.nc";
+    int ncid = -1;
+    int varid = -1;
+};
+
+// --------------------------------------------------------------------
+// test implementations
+
+// Test reading one z slice at a time
+TEST_F (netcdf_slab_readerTests, slices)
+{
+  nc_slab_reader<3,int> reader (ncid, varid);
+  ASSERT_EQ ((reader.dims()), (n88::tuplet<3,size_t>(5,3,4)));
+  ASSERT_EQ (reader.number_of_slabs(), 5);
+  n88::const_array<3,int> slab;
+  size_t count = 0;
+  while (reader.next (slab))
+  {
+    ASSERT_EQ (reader.position(), count);
+    ASSERT_EQ ((slab.dims()), (n88::tuplet<3,size_t>(1,3,4)));
+    for (size_t i=0; i<slab.size(); ++i)
+    { ASSERT_EQ (slab[i], int(count*12 + i)); }
+    ++count;
+  }
+  ASSERT_EQ (count, 5);
+  ASSERT_FALSE (slab.is_constructed());
+}
+
+// Test that the last slab is thinner when thickness does not divide the
+// first dimension
+TEST_F (netcdf_slab_readerTests, thick_slabs)
+{
+  nc_slab_reader<3,int> reader (ncid, varid, 2);
+  ASSERT_EQ (reader.number_of_slabs(), 3);
+  n88::const_array<3,int> slab;
+  std::vector<int> values;
+  while (reader.next (slab))
+  {
+    ASSERT_EQ (slab.dims()[0], reader.position() < 4 ? 2u : 1u);
+    values.insert (values.end(), slab.begin(), slab.end());
+  }
+  ASSERT_EQ (values.size(), 5*3*4);
+  for (size_t i=0; i<values.size(); ++i)
+  { ASSERT_EQ (values[i], int(i)); }
+}
+
+// Test that the reader can be abandoned part way through
+TEST_F (netcdf_slab_readerTests, early_exit)
+{
+  nc_slab_reader<3,int> reader (ncid, varid);
+  n88::const_array<3,int> slab;
+  ASSERT_TRUE (reader.next (slab));
+  ASSERT_EQ (slab[0], 0);
+}
+
+// Test that errors from the NetCDF library are reported as exceptions
+TEST_F (netcdf_slab_readerTests, errors)
+{
+  ASSERT_THROW ((nc_slab_reader<3,int> (ncid, varid + 100)), n88::n88_exception);
+  ASSERT_THROW ((nc_slab_reader<2,int> (ncid, varid)), n88::n88_exception);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "n88util/netcdf_slab_writer.hpp"
+#include "n88util/array.hpp"
+#include "n88util/exception.hpp"
+#include <netcdf.h>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace n88util;
+
+// Create a test fixture class.
+class netcdf_slab_writerTests : public ::testing::Test
+{
+  protected:
+
+    // Defines a 5x3x4 float variable.
+    void SetUp () override
+    {
+      ASSERT_EQ (nc_create (filename, NC_NETCDF4 | NC_CLOBBER, &ncid), NC_NOERR);
+      int dimids[3];
+      ASSERT_EQ (nc_def_dim (ncid, "z", 5, &dimids[0]), NC_NOERR);
+      ASSERT_EQ (nc_def_dim (ncid, "y", 3, &dimids[1]), NC_NOERR);
+      ASSERT_EQ (nc_def_dim (ncid, "x", 4, &dimids[2]), NC_NOERR);
+      ASSERT_EQ (nc_def_var (ncid, "values", NC_FLOAT, 3, dimids, &varid), NC_NOERR);
+      ASSERT_EQ (nc_enddef (ncid), NC_NOERR);
+    }
+
+    void TearDown () override
+    {
+      nc_close (ncid);
+      std::remove (filename);
+    }
+
+    const char* filename = "netcdf_slab_writerTests.nc";
+    int ncid = -1;
+    int varid = -1;
+};
+
+// --------------------------------------------------------------------
+// test implementations
+
+// Test writing one z slice at a time through a queue of length one,
+// reusing the same slab for each put
+TEST_F (netcdf_slab_writerTests, round_trip)
+{
+  {
+    nc_slab_writer<3,float> writer (ncid, varid, 1);
+    n88::array<3,float> slab (1,3,4);
+    for (size_t z=0; z<5; ++z)
+    {
+      for (size_t i=0; i<slab.size(); ++i)
+      { slab[i] = float(z*12 + i); }
+      writer.put (slab, z);
+    }
+    writer.flush();
+    ASSERT_EQ (writer.written(), 5);
+    ASSERT_EQ (writer.pending(), 0);
+  }
+  std::vector<float> values (5*3*4);
+  ASSERT_EQ (nc_get_var_float (ncid, varid, values.data()), NC_NOERR);
+  for (size_t i=0; i<values.size(); ++i)
+  { ASSERT_EQ (values[i], float(i)); }
+}
+
+// Test writing a hyperslab at an arbitrary start
+TEST_F (netcdf_slab_writerTests, hyperslab)
+{
+  {
+    nc_slab_writer<3,float> writer (ncid, varid);
+    n88::array<3,float> slab (2,2,2);
+    for (size_t i=0; i<slab.size(); ++i)
+    { slab[i] = float(i + 1); }
+    writer.put (slab, n88::tuplet<3,size_t>(3,1,2));
+    writer.flush();
+    ASSERT_EQ (writer.written(), 1);
+  }
+  float value = 0;
+  const size_t index[3] = {4,2,3};
+  ASSERT_EQ (nc_get_var1_float (ncid, varid, index, &value), NC_NOERR);
+  ASSERT_EQ (value, 8);
+}
+
+// Test that a failed write is reported by the next put and by flush
+TEST_F (netcdf_slab_writerTests, errors)
+{
+  nc_slab_writer<3,float> writer (ncid, varid, 1);
+  n88::array<3,float> slab (1,3,4);
+  slab.zero();
+  writer.put (slab, size_t(0));
+  // Past the end of a fixed dimension.
+  writer.put (slab, size_t(10));
+  while (writer.pending() > 0)
+  { std::this_thread::yield(); }
+  ASSERT_EQ (writer.written(), 1);
+  ASSERT_THROW (writer.put (slab, size_t(1)), n88::n88_exception);
+  ASSERT_THROW (writer.flush(), n88::n88_exception);
+}
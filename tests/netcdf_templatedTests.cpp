@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "n88util/netcdf_templated.hpp"
+#include <netcdf.h>
+#include <cstdio>
+#include <type_traits>
+
+using namespace n88util;
+
+// Create a typed test fixture class, with a file holding a 2x3 variable
+// of the external type that corresponds to TypeParam.
+template <typename T>
+class netcdf_templatedTests : public ::testing::Test
+{
+  protected:
+
+    void SetUp () override
+    {
+      ASSERT_EQ (nc_create (filename, NC_NETCDF4 | NC_CLOBBER, &ncid), NC_NOERR);
+      int dimids[2];
+      ASSERT_EQ (nc_def_dim (ncid, "y", 2, &dimids[0]), NC_NOERR);
+      ASSERT_EQ (nc_def_dim (ncid, "x", 3, &dimids[1]), NC_NOERR);
+      ASSERT_EQ (nc_def_var (ncid, "values", nc_traits<T>::type, 2, dimids, &varid), NC_NOERR);
+      ASSERT_EQ (nc_enddef (ncid), NC_NOERR);
+    }
+
+    void TearDown () override
+    {
+      nc_close (ncid);
+      std::remove (filename);
+    }
+
+    const char* filename = "netcdf_templatedTests.nc";
+    int ncid = -1;
+    int varid = -1;
+};
+
+typedef ::testing::Types<signed char, unsigned char,
+                         short, unsigned short,
+                         int, unsigned int,
+                         long, unsigned long,
+                         long long, unsigned long long,
+                         float, double> nc_types;
+TYPED_TEST_SUITE (netcdf_templatedTests, nc_types);
+
+// --------------------------------------------------------------------
+// test implementations
+
+// Test that the external type matches the size and signedness of the
+// C++ type, including for the forwarded long and unsigned long
+TYPED_TEST (netcdf_templatedTests, type)
+{
+  nc_type xtype = NC_NAT;
+  ASSERT_EQ (nc_inq_vartype (this->ncid, this->varid, &xtype), NC_NOERR);
+  ASSERT_EQ (xtype, nc_traits<TypeParam>::type);
+  if (std::is_integral<TypeParam>::value)
+  {
+    const bool is_signed = std::is_signed<TypeParam>::value;
+    switch (sizeof(TypeParam))
+    {
+      case 1: ASSERT_EQ (xtype, is_signed ? NC_BYTE : NC_UBYTE); break;
+      case 2: ASSERT_EQ (xtype, is_signed ? NC_SHORT : NC_USHORT); break;
+      case 4: ASSERT_EQ (xtype, is_signed ? NC_INT : NC_UINT); break;
+      case 8: ASSERT_EQ (xtype, is_signed ? NC_INT64 : NC_UINT64); break;
+      default: FAIL();
+    }
+  }
+}
+
+// Test put_var and get_var
+TYPED_TEST (netcdf_templatedTests, var)
+{
+  const TypeParam values[6] = {1, 2, 3, 4, 5, 127};
+  ASSERT_EQ (nc_put_var (this->ncid, this->varid, values), NC_NOERR);
+  TypeParam result[6] = {};
+  ASSERT_EQ (nc_get_var (this->ncid, this->varid, result), NC_NOERR);
+  for (int i=0; i<6; ++i)
+  { ASSERT_EQ (result[i], values[i]); }
+}
+
+// Test put_var1 and get_var1
+TYPED_TEST (netcdf_templatedTests, var1)
+{
+  const size_t index[2] = {1, 2};
+  const TypeParam value = 42;
+  ASSERT_EQ (nc_put_var1 (this->ncid, this->varid, index, &value), NC_NOERR);
+  TypeParam result = 0;
+  ASSERT_EQ (nc_get_var1 (this->ncid, this->varid, index, &result), NC_NOERR);
+  ASSERT_EQ (result, value);
+}
+
+// Test put_vara and get_vara
+TYPED_TEST (netcdf_templatedTests, vara)
+{
+  const size_t start[2] = {0, 1};
+  const size_t count[2] = {2, 2};
+  const TypeParam values[4] = {10, 11, 12, 13};
+  ASSERT_EQ (nc_put_vara (this->ncid, this->varid, start, count, values), NC_NOERR);
+  TypeParam result[4] = {};
+  ASSERT_EQ (nc_get_vara (this->ncid, this->varid, start, count, result), NC_NOERR);
+  for (int i=0; i<4; ++i)
+  { ASSERT_EQ (result[i], values[i]); }
+}
+
+// Test put_vars and get_vars
+TYPED_TEST (netcdf_templatedTests, vars)
+{
+  const size_t start[2] = {0, 0};
+  const size_t count[2] = {2, 2};
+  const ptrdiff_t stride[2] = {1, 2};
+  const TypeParam values[4] = {20, 21, 22, 23};
+  ASSERT_EQ (nc_put_vars (this->ncid, this->varid, start, count, stride, values), NC_NOERR);
+  TypeParam all[6] = {};
+  ASSERT_EQ (nc_get_var (this->ncid, this->varid, all), NC_NOERR);
+  ASSERT_EQ (all[0], 20);
+  ASSERT_EQ (all[2], 21);
+  ASSERT_EQ (all[3], 22);
+  ASSERT_EQ (all[5], 23);
+  TypeParam result[4] = {};
+  ASSERT_EQ (nc_get_vars (this->ncid, this->varid, start, count, stride, result), NC_NOERR);
+  for (int i=0; i<4; ++i)
+  { ASSERT_EQ (result[i], values[i]); }
+}
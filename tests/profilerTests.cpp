@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include "n88util/profiler.hpp"
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+
+// Create a test fixture class.
+class profilerTests : public ::testing::Test
+{
+  protected:
+
+    void SetUp () override
+    {
+      n88::profiler::Reset();
+      n88::profiler::SetEnabled (true);
+    }
+
+    void TearDown () override
+    {
+      n88::profiler::SetEnabled (false);
+      n88::profiler::SetTraceEnabled (false);
+      n88::profiler::SetCountersEnabled (false);
+      n88::profiler::Reset();
+    }
+
+    struct row
+    {
+      int depth;
+      unsigned long calls;
+      double total;
+      double self;
+      double mean;
+      double min;
+      double max;
+    };
+
+    // Parses the report into rows indexed by region name.
+    static std::map<std::string, row> ParseReport ()
+    {
+      std::ostringstream out;
+      n88::profiler::Report (out);
+      std::istringstream in (out.str());
+      std::string line;
+      std::getline (in, line);
+      std::map<std::string, row> rows;
+      while (std::getline (in, line))
+      {
+        row r;
+        r.depth = (int)line.find_first_not_of (' ') / 2;
+        std::istringstream fields (line);
+        std::string name;
+        fields >> name >> r.calls >> r.total >> r.self >> r.mean >> r.min >> r.max;
+        rows[name] = r;
+      }
+      return rows;
+    }
+};
+
+namespace
+{
+  void sleep_ms (int ms)
+  { std::this_thread::sleep_for (std::chrono::milliseconds (ms)); }
+
+  // The number of open file descriptors, or 0 if unknown.
+  int count_fds ()
+  {
+    int count = 0;
+#ifdef __linux__
+    DIR* dir = opendir ("/proc/self/fd");
+    if (!dir)
+    { return 0; }
+    while (readdir (dir))
+    { ++count; }
+    closedir (dir);
+#endif
+    return count;
+  }
+}
+
+// --------------------------------------------------------------------
+// test implementations
+
+TEST_F (profilerTests, disabled)
+{
+  n88::profiler::SetEnabled (false);
+  {
+    N88_PROFILE_SCOPE ("disabled_region");
+  }
+  ASSERT_EQ (ParseReport().count ("disabled_region"), 0);
+}
+
+TEST_F (profilerTests, nested)
+{
+  {
+    N88_PROFILE_SCOPE ("outer");
+    sleep_ms (20);
+    for (int i=0; i<3; ++i)
+    {
+      N88_PROFILE_SCOPE ("inner");
+      sleep_ms (10);
+    }
+  }
+  std::map<std::string, row> rows = ParseReport();
+  ASSERT_EQ (rows.size(), 2);
+  const row& outer = rows["outer"];
+  const row& inner = rows["inner"];
+  ASSERT_EQ (outer.depth, 0);
+  ASSERT_EQ (outer.calls, 1);
+  ASSERT_EQ (inner.depth, 1);
+  ASSERT_EQ (inner.calls, 3);
+  ASSERT_GE (outer.total, 0.05);
+  ASSERT_GE (outer.self, 0.02);
+  ASSERT_LT (outer.self, outer.total - 0.025);
+  ASSERT_GE (inner.total, 0.03);
+  ASSERT_DOUBLE_EQ (inner.total, inner.self);
+  ASSERT_GE (inner.min, 10.0);
+  ASSERT_LE (inner.min, inner.mean);
+  ASSERT_LE (inner.mean, inner.max);
+}
+
+// The same region on different paths is reported separately.
+TEST_F (profilerTests, paths)
+{
+  {
+    N88_PROFILE_SCOPE ("step");
+    N88_PROFILE_SCOPE ("solve");
+  }
+  {
+    N88_PROFILE_SCOPE ("setup");
+  }
+  std::ostringstream out;
+  n88::profiler::Report (out);
+  const std::string report = out.str();
+  const size_t step = report.find ("\nstep ");
+  const size_t solve = report.find ("\n  solve ");
+  const size_t setup = report.find ("\nsetup ");
+  ASSERT_NE (step, std::string::npos);
+  ASSERT_NE (solve, std::string::npos);
+  ASSERT_NE (setup, std::string::npos);
+  ASSERT_LT (step, solve);
+  ASSERT_LT (solve, setup);
+}
+
+TEST_F (profilerTests, threads)
+{
+  std::vector<std::thread> threads;
+  for (int i=0; i<4; ++i)
+  {
+    threads.push_back (std::thread ([] ()
+      {
+        for (int j=0; j<100; ++j)
+        { N88_PROFILE_SCOPE ("worker"); }
+      }));
+  }
+  for (std::thread& t : threads)
+  { t.join(); }
+  ASSERT_EQ (ParseReport()["worker"].calls, 400);
+}
+
+TEST_F (profilerTests, reset)
+{
+  {
+    N88_PROFILE_SCOPE ("before_reset");
+  }
+  n88::profiler::Reset();
+  ASSERT_EQ (ParseReport().count ("before_reset"), 0);
+}
+
+TEST_F (profilerTests, chrome_trace)
+{
+  n88::profiler::SetTraceEnabled (true, 3);
+  for (int i=0; i<2; ++i)
+  {
+    N88_PROFILE_SCOPE ("quote\"d");
+    N88_PROFILE_SCOPE ("traced");
+  }
+  std::ostringstream out;
+  n88::profiler::WriteChromeTrace (out);
+  const std::string trace = out.str();
+  ASSERT_EQ (trace.compare (0, 16, "{\"traceEvents\":["), 0);
+  ASSERT_NE (trace.find ("\"name\":\"quote\\\"d\",\"ph\":\"X\",\"ts\":"), std::string::npos);
+  // Only 3 events are kept.
+  size_t count = 0;
+  for (size_t p = trace.find ("\"ph\":\"X\""); p != std::string::npos; p = trace.find ("\"ph\":\"X\"", p+1))
+  { ++count; }
+  ASSERT_EQ (count, 3);
+}
+
+// Counters may not be available; either way regions are still timed.
+TEST_F (profilerTests, counters)
+{
+  const bool available = n88::profiler::SetCountersEnabled (true);
+  ASSERT_EQ (n88::profiler::GetCountersEnabled(), available);
+  {
+    N88_PROFILE_SCOPE ("counted");
+    volatile double x = 0;
+    for (int i=0; i<100000; ++i)
+    { x = x + 1; }
+  }
+  std::ostringstream out;
+  n88::profiler::Report (out);
+  ASSERT_EQ (out.str().find ("IPC") != std::string::npos, available);
+  ASSERT_EQ (ParseReport()["counted"].calls, 1);
+}
+
+// Threads that exit release their counters, but their timings and events
+// are kept.
+TEST_F (profilerTests, exited_threads)
+{
+  n88::profiler::SetCountersEnabled (true);
+  n88::profiler::SetTraceEnabled (true);
+  const int fds = count_fds();
+  for (int i=0; i<50; ++i)
+  {
+    std::thread ([] ()
+      {
+        N88_PROFILE_SCOPE ("exited");
+        N88_PROFILE_SCOPE ("exited_inner");
+      }).join();
+  }
+  ASSERT_EQ (count_fds(), fds);
+  std::map<std::string, row> rows = ParseReport();
+  ASSERT_EQ (rows["exited"].calls, 50);
+  ASSERT_EQ (rows["exited_inner"].depth, 1);
+  ASSERT_EQ (rows["exited_inner"].calls, 50);
+  std::ostringstream out;
+  n88::profiler::WriteChromeTrace (out);
+  const std::string trace = out.str();
+  size_t count = 0;
+  for (size_t p = trace.find ("\"name\":\"exited\""); p != std::string::npos; p = trace.find ("\"name\":\"exited\"", p+1))
+  { ++count; }
+  ASSERT_EQ (count, 50);
+  n88::profiler::Reset();
+  ASSERT_EQ (ParseReport().count ("exited"), 0);
+}
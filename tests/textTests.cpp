@@ -73,3 +73,106 @@ TEST_F (textTests, split_trim_consecutive_separators)
   ASSERT_EQ(tokens[2], "");
   ASSERT_EQ(tokens[3], "five");
 }
+
+// Test split_arguments returning views.
+TEST_F (textTests, split_arguments_string_view)
+{
+  std::string input = "  one  two\t,3 four,five";
+  std::vector<std::string_view> tokens;
+  n88util::split_arguments(input, tokens);
+  ASSERT_EQ(tokens.size(), 5);
+  ASSERT_EQ(tokens[0], "one");
+  ASSERT_EQ(tokens[1], "two");
+  ASSERT_EQ(tokens[2], "3");
+  ASSERT_EQ(tokens[3], "four");
+  ASSERT_EQ(tokens[4], "five");
+  ASSERT_EQ(tokens[0].data(), input.data() + 2);
+  // Reusing the vector with precomputed separators.
+  const n88util::separator_set separators("f3");
+  n88util::split_arguments(input, tokens, separators);
+  ASSERT_EQ(tokens.size(), 4);
+  ASSERT_EQ(tokens[0], "  one  two\t,");
+  ASSERT_EQ(tokens[1], " ");
+  ASSERT_EQ(tokens[2], "our,");
+  ASSERT_EQ(tokens[3], "ive");
+}
+
+// Test split_trim returning views.
+TEST_F (textTests, split_trim_string_view)
+{
+  std::string input = "one, two\t3 four,,five ,";
+  std::vector<std::string_view> tokens;
+  n88util::split_trim(input, tokens);
+  ASSERT_EQ(tokens.size(), 5);
+  ASSERT_EQ(tokens[0], "one");
+  ASSERT_EQ(tokens[1], "two\t3 four");
+  ASSERT_EQ(tokens[2], "");
+  ASSERT_EQ(tokens[3], "five");
+  ASSERT_EQ(tokens[4], "");
+  n88util::split_trim("", tokens);
+  ASSERT_EQ(tokens.size(), 0);
+}
+
+// Test the callback form.
+TEST_F (textTests, for_each_argument)
+{
+  const n88util::separator_set separators(" ");
+  int count = 0;
+  size_t total_length = 0;
+  n88util::for_each_argument("12 345  6789 ", separators,
+                             [&](std::string_view t) { count++; total_length += t.size(); });
+  ASSERT_EQ(count, 3);
+  ASSERT_EQ(total_length, 9);
+}
+
+// test separator_set on long strings, which are scanned in blocks
+TEST_F (textTests, separator_set_long)
+{
+  // Every position, both within and at the end of a vector block.
+  for (size_t n=0; n<100; n++)
+  {
+    for (size_t i=0; i<=n; i++)
+    {
+      std::string s(n, 'a');
+      if (i < n)
+      {
+        s[i] = ',';
+      }
+      const n88util::separator_set separators(" ,");
+      ASSERT_EQ(separators.find_first(s.data(), s.data()+n), s.data()+i);
+      std::string t(n, ' ');
+      if (i < n)
+      {
+        t[i] = '\x80';
+      }
+      ASSERT_EQ(separators.find_first_not(t.data(), t.data()+n), t.data()+i);
+    }
+  }
+  // Non-ASCII separators.
+  const n88util::separator_set high("\xA0");
+  std::string s(70, 'x');
+  s[65] = '\xA0';
+  ASSERT_EQ(high.find_first(s.data(), s.data()+s.size()), s.data()+65);
+  // Characters differing from a separator only in the high nibble must
+  // not match.
+  const n88util::separator_set tab("\t");
+  std::string u(40, '\x19');
+  u[33] = '\t';
+  ASSERT_EQ(tab.find_first(u.data(), u.data()+u.size()), u.data()+33);
+}
+
+// test splitting a long string
+TEST_F (textTests, split_arguments_long)
+{
+  std::string input;
+  std::vector<std::string> expected;
+  for (int i=0; i<1000; i++)
+  {
+    expected.push_back(std::string(i % 40 + 1, char('a' + i % 26)));
+    input += expected.back();
+    input += std::string(i % 37 + 1, i % 2 ? ' ' : ',');
+  }
+  std::vector<std::string> tokens;
+  n88util::split_arguments(input, tokens);
+  ASSERT_EQ(tokens, expected);
+}
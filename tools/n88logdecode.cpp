@@ -0,0 +1,34 @@
+// Copyright (c) Eric Nodwell
+// See LICENSE for details.
+
+// Converts a binary log written by n88::io::logger to text.
+
+#include "n88util/binary_log.hpp"
+#include "n88util/exception.hpp"
+#include <fstream>
+#include <iostream>
+
+int main (int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: n88logdecode <binary log file>\n";
+    return 1;
+  }
+  std::ifstream in (argv[1], std::ios::in | std::ios::binary);
+  if (!in)
+  {
+    std::cerr << "Unable to open " << argv[1] << "\n";
+    return 1;
+  }
+  try
+  {
+    n88::io::decode_binary_log (in, std::cout);
+  }
+  catch (const n88::n88_exception& e)
+  {
+    std::cerr << argv[1] << ": " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}